@@ -0,0 +1,154 @@
+#include "acpi.h"
+
+/* Root System Description Pointer (ACPI 1.0 part) */
+typedef struct {
+    char     signature[8];      /* "RSD PTR " */
+    uint8_t  checksum;
+    char     oem_id[6];
+    uint8_t  revision;
+    uint32_t rsdt_addr;
+} __attribute__((packed)) rsdp_t;
+
+/* Header shared by the RSDT and every table it lists */
+typedef struct {
+    char     signature[4];
+    uint32_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem_id[6];
+    char     oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) sdt_header_t;
+
+typedef struct {
+    sdt_header_t h;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} __attribute__((packed)) madt_t;
+
+#define MADT_PCAT_COMPAT    0x01
+
+/* MADT entry types */
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_OVERRIDE       2
+#define MADT_LAPIC_ADDR     5
+
+#define LAPIC_ENABLED       0x01
+
+#define BDA_EBDA_SEGMENT    0x40E
+#define BIOS_AREA_START     0xE0000
+#define BIOS_AREA_END       0x100000
+
+static uint8_t checksum(const void *p, uint32_t len) {
+    const uint8_t *b = (const uint8_t *)p;
+    uint8_t sum = 0;
+    while (len--)
+        sum += *b++;
+    return sum;
+}
+
+static int sig_is(const char *s, const char *sig, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++)
+        if (s[i] != sig[i])
+            return 0;
+    return 1;
+}
+
+/* The RSDP sits on a 16-byte boundary in [start, end) */
+static const rsdp_t *scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t a = start & ~15u; a + sizeof(rsdp_t) <= end; a += 16) {
+        const rsdp_t *r = (const rsdp_t *)a;
+        if (sig_is(r->signature, "RSD PTR ", 8) && checksum(r, sizeof(rsdp_t)) == 0)
+            return r;
+    }
+    return 0;
+}
+
+static const rsdp_t *find_rsdp(void) {
+    /* Through a pointer GCC cannot see the value of: it takes constant
+     * addresses in the first page for null-pointer arithmetic and warns */
+    const volatile uint16_t *bda_ebda;
+    __asm__("" : "=r"(bda_ebda) : "0"(BDA_EBDA_SEGMENT));
+    uint32_t ebda = (uint32_t)*bda_ebda << 4;
+    const rsdp_t *r = 0;
+
+    if (ebda >= 0x80000 && ebda < 0xA0000)
+        r = scan_rsdp(ebda, ebda + 1024);
+    if (r == 0)
+        r = scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+    return r;
+}
+
+static const sdt_header_t *valid_table(uint32_t addr, const char *sig) {
+    const sdt_header_t *h = (const sdt_header_t *)addr;
+    if (addr == 0 || !sig_is(h->signature, sig, 4) || h->length < sizeof(sdt_header_t))
+        return 0;
+    return checksum(h, h->length) == 0 ? h : 0;
+}
+
+static const madt_t *find_madt(void) {
+    const rsdp_t *rsdp = find_rsdp();
+    if (rsdp == 0)
+        return 0;
+    const sdt_header_t *rsdt = valid_table(rsdp->rsdt_addr, "RSDT");
+    if (rsdt == 0)
+        return 0;
+
+    const uint32_t *entry = (const uint32_t *)(rsdt + 1);
+    uint32_t n = (rsdt->length - sizeof(sdt_header_t)) / 4;
+    for (uint32_t i = 0; i < n; i++) {
+        const sdt_header_t *h = valid_table(entry[i], "APIC");
+        if (h && h->length >= sizeof(madt_t))
+            return (const madt_t *)h;
+    }
+    return 0;
+}
+
+static uint32_t rd32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int acpi_parse_madt(acpi_madt_t *out) {
+    const madt_t *madt = find_madt();
+    if (madt == 0)
+        return -1;
+
+    out->lapic_addr = madt->lapic_addr;
+    out->pcat_compat = (madt->flags & MADT_PCAT_COMPAT) != 0;
+    out->cpu_count = 0;
+    out->ioapic_count = 0;
+    out->override_count = 0;
+
+    const uint8_t *p = (const uint8_t *)(madt + 1);
+    const uint8_t *end = (const uint8_t *)madt + madt->h.length;
+    while (p + 2 <= end && p[1] >= 2 && p + p[1] <= end) {
+        uint8_t type = p[0], len = p[1];
+
+        if (type == MADT_LAPIC && len >= 8) {
+            if ((rd32(p + 4) & LAPIC_ENABLED) && out->cpu_count < ACPI_MAX_CPUS)
+                out->cpu_apic_id[out->cpu_count++] = p[3];
+        } else if (type == MADT_IOAPIC && len >= 12) {
+            if (out->ioapic_count < ACPI_MAX_IOAPICS) {
+                acpi_ioapic_t *io = &out->ioapic[out->ioapic_count++];
+                io->id = p[2];
+                io->addr = rd32(p + 4);
+                io->gsi_base = rd32(p + 8);
+            }
+        } else if (type == MADT_OVERRIDE && len >= 10) {
+            if (p[2] == 0 && out->override_count < ACPI_MAX_OVERRIDES) {   /* bus 0: ISA */
+                acpi_override_t *o = &out->override[out->override_count++];
+                o->irq = p[3];
+                o->gsi = rd32(p + 4);
+                o->flags = (uint16_t)(p[8] | p[9] << 8);
+            }
+        } else if (type == MADT_LAPIC_ADDR && len >= 12) {
+            if (rd32(p + 8) == 0)       /* only usable below 4 GiB */
+                out->lapic_addr = rd32(p + 4);
+        }
+        p += len;
+    }
+    return 0;
+}
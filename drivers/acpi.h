@@ -0,0 +1,48 @@
+#ifndef INCLUDE_ACPI_H
+#define INCLUDE_ACPI_H
+
+#include "types.h"
+
+// ACPI tables, as far as interrupt routing needs them. The RSDP is looked
+// for in the EBDA and the BIOS area (0xE0000-0xFFFFF), the MADT through
+// the RSDT; every table's checksum is verified. Memory is not paged, so
+// the tables are read where the firmware left them.
+#define ACPI_MAX_CPUS      16
+#define ACPI_MAX_IOAPICS   4
+#define ACPI_MAX_OVERRIDES 16
+
+// MPS INTI flags of an interrupt source override
+#define ACPI_POLARITY_MASK  0x03
+#define ACPI_POLARITY_LOW   0x03
+#define ACPI_TRIGGER_MASK   0x0C
+#define ACPI_TRIGGER_LEVEL  0x0C
+
+typedef struct {
+    uint8_t  id;
+    uint32_t addr;
+    uint32_t gsi_base;      /* first global system interrupt it serves */
+} acpi_ioapic_t;
+
+typedef struct {
+    uint8_t  irq;           /* ISA IRQ */
+    uint32_t gsi;           /* the I/O APIC input it is wired to */
+    uint16_t flags;         /* ACPI_POLARITY_* / ACPI_TRIGGER_* (0: ISA default) */
+} acpi_override_t;
+
+// What the MADT ("APIC" table) says about the interrupt controllers
+typedef struct {
+    uint32_t lapic_addr;
+    uint8_t  pcat_compat;   /* dual 8259 present as well */
+    uint8_t  cpu_count;     /* enabled processors */
+    uint8_t  cpu_apic_id[ACPI_MAX_CPUS];
+    uint8_t  ioapic_count;
+    acpi_ioapic_t ioapic[ACPI_MAX_IOAPICS];
+    uint8_t  override_count;
+    acpi_override_t override[ACPI_MAX_OVERRIDES];
+} acpi_madt_t;
+
+// Fill `out` from the MADT. Returns 0, or -1 if there is no valid RSDP,
+// RSDT or MADT.
+int acpi_parse_madt(acpi_madt_t *out);
+
+#endif
@@ -0,0 +1,179 @@
+#include "apic.h"
+
+/* Local APIC registers (byte offsets) */
+#define LAPIC_ID         0x020
+#define LAPIC_TPR        0x080
+#define LAPIC_SVR        0x0F0
+#define LAPIC_LVT_TIMER  0x320
+#define LAPIC_LVT_LINT0  0x350
+#define LAPIC_LVT_ERROR  0x370
+
+#define LVT_MASKED       0x10000
+#define SVR_ENABLE       0x100
+
+#define MSR_APIC_BASE    0x1B
+#define APIC_BASE_BSP    0x100
+#define APIC_BASE_ENABLE 0x800
+
+#define CPUID_EDX_APIC   (1u << 9)
+
+/* I/O APIC: an index register and a data window */
+#define IOAPIC_REGSEL    0x00
+#define IOAPIC_WIN       0x10
+#define IOAPIC_VER       0x01
+#define IOAPIC_REDTBL(n) (0x10 + 2 * (n))
+
+#define RTE_POLARITY_LOW (1u << 13)
+#define RTE_LEVEL        (1u << 15)
+#define RTE_MASKED       (1u << 16)
+
+#define NO_GSI           0xFFFFFFFFu
+
+volatile uint32_t *apic_lapic = 0;
+
+static const acpi_madt_t *madt_info;
+static uint8_t bsp_id = 0;
+static uint32_t ioapic_pins[ACPI_MAX_IOAPICS];  /* redirection entries per I/O APIC */
+
+/* Routing of each ISA IRQ, set by apic_route_irq() */
+static uint32_t irq_gsi[16];
+static uint32_t irq_rte[16];                    /* low half of its entry */
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return apic_lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    apic_lapic[reg / 4] = value;
+}
+
+static uint32_t ioapic_read(uint32_t base, uint8_t reg) {
+    *(volatile uint32_t *)(base + IOAPIC_REGSEL) = reg;
+    return *(volatile uint32_t *)(base + IOAPIC_WIN);
+}
+
+static void ioapic_write(uint32_t base, uint8_t reg, uint32_t value) {
+    *(volatile uint32_t *)(base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t *)(base + IOAPIC_WIN) = value;
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static int cpu_has_apic(void) {
+    uint32_t a = 1, b, c, d;
+    __asm__ __volatile__("cpuid" : "+a"(a), "=b"(b), "=c"(c), "=d"(d));
+    return (d & CPUID_EDX_APIC) != 0;
+}
+
+/* I/O APIC serving input `gsi`, and the entry number on it (-1 if none) */
+static int find_ioapic(uint32_t gsi, uint8_t *pin) {
+    for (uint8_t i = 0; i < madt_info->ioapic_count; i++) {
+        const acpi_ioapic_t *io = &madt_info->ioapic[i];
+        if (gsi >= io->gsi_base && gsi - io->gsi_base < ioapic_pins[i]) {
+            *pin = (uint8_t)(gsi - io->gsi_base);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void write_rte(uint32_t gsi, uint32_t low) {
+    uint8_t pin;
+    int i = find_ioapic(gsi, &pin);
+    if (i < 0)
+        return;
+    uint32_t base = madt_info->ioapic[i].addr;
+    ioapic_write(base, IOAPIC_REDTBL(pin) + 1, (uint32_t)bsp_id << 24);
+    ioapic_write(base, IOAPIC_REDTBL(pin), low);
+}
+
+int apic_init(const acpi_madt_t *madt) {
+    if (!cpu_has_apic() || madt->ioapic_count == 0 || madt->lapic_addr == 0)
+        return -1;
+    madt_info = madt;
+
+    /* Enable the local APIC at the MADT's address and accept everything */
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, (base & APIC_BASE_BSP) | APIC_BASE_ENABLE | (madt->lapic_addr & 0xFFFFF000u));
+    apic_lapic = (volatile uint32_t *)madt->lapic_addr;
+    bsp_id = (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);   /* the 8259's ExtINT line */
+    lapic_write(LAPIC_LVT_ERROR, LVT_MASKED);
+    lapic_write(LAPIC_SVR, SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    apic_eoi();
+
+    for (uint8_t i = 0; i < madt->ioapic_count; i++) {
+        uint32_t addr = madt->ioapic[i].addr;
+        ioapic_pins[i] = ((ioapic_read(addr, IOAPIC_VER) >> 16) & 0xFF) + 1;
+        for (uint32_t pin = 0; pin < ioapic_pins[i]; pin++)
+            ioapic_write(addr, IOAPIC_REDTBL(pin), RTE_MASKED);
+    }
+    for (uint8_t irq = 0; irq < 16; irq++)
+        irq_gsi[irq] = NO_GSI;
+    return 0;
+}
+
+/* ISA IRQ `irq`'s input and its MPS flags: an override for it, else the
+ * identity input - unless an override has moved another IRQ onto that.
+ */
+static uint32_t isa_gsi(uint8_t irq, uint16_t *flags) {
+    *flags = 0;
+    for (uint8_t i = 0; i < madt_info->override_count; i++)
+        if (madt_info->override[i].irq == irq) {
+            *flags = madt_info->override[i].flags;
+            return madt_info->override[i].gsi;
+        }
+    for (uint8_t i = 0; i < madt_info->override_count; i++)
+        if (madt_info->override[i].gsi == irq)
+            return NO_GSI;
+    return irq;
+}
+
+int apic_route_irq(uint8_t irq, uint8_t vector) {
+    uint16_t flags;
+    uint8_t pin;
+
+    if (irq >= 16 || irq == 2)      /* IRQ2 is the 8259 cascade */
+        return -1;
+    uint32_t gsi = isa_gsi(irq, &flags);
+    if (gsi == NO_GSI || find_ioapic(gsi, &pin) < 0)
+        return -1;
+
+    /* Fixed delivery, physical destination; ISA defaults are edge/high */
+    uint32_t low = vector | RTE_MASKED;
+    if ((flags & ACPI_POLARITY_MASK) == ACPI_POLARITY_LOW)
+        low |= RTE_POLARITY_LOW;
+    if ((flags & ACPI_TRIGGER_MASK) == ACPI_TRIGGER_LEVEL)
+        low |= RTE_LEVEL;
+
+    irq_gsi[irq] = gsi;
+    irq_rte[irq] = low;
+    write_rte(gsi, low);
+    return 0;
+}
+
+void apic_unmask_irq(uint8_t irq) {
+    if (irq >= 16 || irq_gsi[irq] == NO_GSI)
+        return;
+    irq_rte[irq] &= ~RTE_MASKED;
+    write_rte(irq_gsi[irq], irq_rte[irq]);
+}
+
+uint8_t apic_id(void) {
+    return bsp_id;
+}
+
+uint32_t apic_gsi(uint8_t irq) {
+    return irq < 16 ? irq_gsi[irq] : NO_GSI;
+}
@@ -0,0 +1,35 @@
+#ifndef INCLUDE_APIC_H
+#define INCLUDE_APIC_H
+
+#include "types.h"
+#include "acpi.h"
+
+// Local APIC and I/O APIC(s) in xAPIC (MMIO) mode, at the addresses the
+// MADT gives. ISA IRQs are routed to this CPU through the I/O APIC input
+// the MADT overrides name (IRQ0 is usually on input 2), edge-triggered
+// and active-high unless an override says otherwise. EOI is a single
+// store to the local APIC.
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// Enable the local APIC and mask every I/O APIC input. Returns -1 if the
+// CPU has no APIC or the MADT lists no I/O APIC. Interrupts off.
+int apic_init(const acpi_madt_t *madt);
+
+// Program ISA IRQ `irq` (0-15) to arrive as `vector`, masked. Returns -1
+// if no I/O APIC input carries it (IRQ2, the 8259 cascade, never has one).
+int apic_route_irq(uint8_t irq, uint8_t vector);
+void apic_unmask_irq(uint8_t irq);
+
+// Local APIC register window, set by apic_init()
+extern volatile uint32_t *apic_lapic;
+
+#define LAPIC_EOI 0x0B0
+
+static inline void apic_eoi(void) {
+    apic_lapic[LAPIC_EOI / 4] = 0;
+}
+
+uint8_t apic_id(void);          // this CPU's local APIC ID
+uint32_t apic_gsi(uint8_t irq); // I/O APIC input of ISA IRQ `irq`
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef INCLUDE_FONT8X8_H
+#define INCLUDE_FONT8X8_H
+
+#include "types.h"
+
+// IBM PC 8x8 glyphs for printable ASCII (FONT8X8_FIRST..0x7E), one byte
+// per scan line with bit 0 as the leftmost pixel. Used for the 8-line VGA
+// text modes and the linear-framebuffer console.
+#define FONT8X8_FIRST  0x20
+#define FONT8X8_GLYPHS 95
+
+extern const uint8_t font8x8_ascii[FONT8X8_GLYPHS][8];
+
+#endif
@@ -1,28 +1,195 @@
 #include "framebuffer.h"
+#include "kprintf.h"
+#include "vga.h"
+#include "lfb.h"
+#include "trace.h"
 
 /* Implementation of a basic VGA text-mode framebuffer driver.
- * This driver writes directly to the VGA text buffer at 0xB8000 and
- * manages a simple software cursor which is also propagated to the
- * hardware cursor via VGA I/O ports (0x3D4/0x3D5).
+ * All drawing goes into an off-screen shadow buffer in normal RAM; rows
+ * that change are marked dirty and copied to the VGA text buffer at
+ * 0xB8000 by fb_flush(). The software cursor is propagated to the
+ * hardware cursor via VGA I/O ports (0x3D4/0x3D5) once per flush rather
+ * than once per character.
+ *
+ * Scrolling never moves the whole screen. Both the shadow buffer and the
+ * 32 KB of VGA text memory are used as sliding windows: a scroll advances
+ * the window start by one row and clears the new bottom row. On the VGA
+ * side the visible window is selected with the CRTC start-address
+ * registers (0x0C/0x0D). Only when a window reaches the end of its buffer
+ * is the screen copied back to the start (one compacting copy per wrap).
  */
 
 /* Pointer to VGA text-mode memory. Each character cell uses two bytes:
- * [character][attribute]. We index by cell and multiply by 2 when
- * writing bytes directly into the buffer.
+ * [character][attribute], accessed here as one 16-bit cell.
 */
-static uint8_t *framebuffer = (uint8_t *)FRAMEBUFFER_ADDRESS;
+static volatile uint16_t *framebuffer = (volatile uint16_t *)FRAMEBUFFER_ADDRESS;
 
-/* Current cursor position and current drawing colours (fg/bg). */
-static uint16_t cursor_x = 0;
-static uint16_t cursor_y = 0;
-static uint8_t current_fg = FRAMEBUFFER_COLOR_LIGHT_GREY;
-static uint8_t current_bg = FRAMEBUFFER_COLOR_BLACK;
+/* Current text-mode geometry (fb_set_mode changes it at runtime). Every
+ * per-console buffer is sized for FB_MAX_WIDTH x FB_MAX_HEIGHT. `scr_h`
+ * is the number of rows on screen; the consoles get `fb_h` of them, one
+ * less while the status line is enabled.
+ */
+static uint16_t fb_w = 80;
+static uint16_t fb_h = 25;
+static uint16_t scr_h = 25;
+static uint16_t fb_cells = 80 * 25;
+static vga_text_mode_t fb_mode = VGA_MODE_80X25;
+
+/* VGA text memory holds 16K cells (~8 screens at 80x25). The first
+ * STATUS_VGA_CELLS belong to the status line; the rest is split into one
+ * page per virtual console when a screen fits in a page at least twice.
+ * Larger modes share all of it (`vga_shared`): only the displayed console
+ * is kept in VGA memory and switching repaints.
+ * `hw_origin` is the start address last programmed into the CRTC (0xFFFF
+ * forces the first flush to write it).
+ */
+#define VGA_RING_CELLS   16384
+#define STATUS_VGA_CELLS FB_MAX_WIDTH
+#define VGA_PAGES_CELLS  (VGA_RING_CELLS - STATUS_VGA_CELLS)
+static uint16_t vga_page_cells = VGA_PAGES_CELLS / FB_NUM_CONSOLES;
+static uint8_t vga_shared = 0;
+static uint16_t hw_origin = 0xFFFF;
+
+/* Linear-framebuffer console (fb_attach_lfb): `framebuffer` then points at
+ * `lfb_text`, a RAM stand-in for VGA text memory, and each flush hands the
+ * displayed screen to lfb_present(). `lfb_scrolled` counts the rows the
+ * displayed screen moved up since the last present.
+ */
+static uint8_t lfb_active = 0;
+static uint16_t lfb_text[VGA_RING_CELLS] __attribute__((aligned(4)));
+static uint16_t lfb_scrolled = 0;
+
+/* Status line: one row below the consoles that never scrolls. In text
+ * mode the CRTC line-compare register splits the screen above it, and
+ * the split part is displayed from VGA address 0, where the status row
+ * lives; the consoles' pages start after it. `status_cells` is written by
+ * fb_status_set() (also from IRQ context), `status_shown` is what VGA
+ * memory holds, so a flush only touches the cells that changed.
+ */
+static uint8_t status_on = 0;
+static uint16_t status_cells[FB_MAX_WIDTH];
+static uint16_t status_shown[FB_MAX_WIDTH];
+static volatile uint8_t status_dirty = 0;
+
+/* Mouse pointer: one cell of the displayed screen drawn with its colours
+ * flipped, in VGA memory only, so shadow buffers and selections never see
+ * it. fb_pointer_move() (also from IRQ context) only sets
+ * `pointer_target` (y << 16 | x); each flush puts back the cell it
+ * flipped last (`pointer_at`, a VGA memory index) unless that row has
+ * been rewritten since, then flips the cell under the new position.
+ */
+#define POINTER_HIDDEN  0xFFFFFFFFu
+#define POINTER_NONE    0xFFFF
+#define POINTER_XOR     0x7700
+static volatile uint32_t pointer_target = POINTER_HIDDEN;
+static uint32_t pointer_drawn = POINTER_HIDDEN;
+static uint16_t pointer_at = POINTER_NONE;
+static uint16_t pointer_cell;   /* value written at pointer_at */
+
+#define FB_SHADOW_SCREENS 4
+
+/* Numeric parameters kept per ANSI control sequence (extras are dropped) */
+#define FB_ANSI_MAX_PARAMS 8
+
+/* Per-console state. Each virtual console owns:
+ * - a shadow copy of its screen in RAM, one 16-bit cell per character,
+ *   plus one dirty bit per row (up to 64 rows in one word). `shadow`
+ *   points at the current window inside `shadow_buf`; row 0 of the screen
+ *   is shadow[0..WIDTH-1];
+ * - a page of VGA memory starting at `vga_base`, inside which the visible
+ *   screen starts at `vga_origin` (scrolling slides it forward); with a
+ *   shared page this is only meaningful while the console is displayed;
+ * - a scrollback ring of FB_SCROLLBACK_LINES lines of packed cells, each
+ *   FB_MAX_WIDTH wide whatever the mode (`hist_head` is the slot the next
+ *   line goes into);
+ * - its own cursor, colours and history view position;
+ * - the current selection (see "Selection" below);
+ * - the state of its ANSI escape parser (see "ANSI escape sequences").
+ */
+typedef struct {
+    uint16_t shadow_buf[FB_SHADOW_SCREENS * FB_MAX_CELLS] __attribute__((aligned(4)));
+    uint16_t history[FB_SCROLLBACK_LINES * FB_MAX_WIDTH] __attribute__((aligned(4)));
+    uint16_t *shadow;
+    uint64_t dirty_rows;
+
+    uint32_t hist_head;
+    uint32_t hist_count;
+
+    /* How many lines back the screen is scrolled into history. Keyboard
+     * handlers only set `view_target`; fb_flush() applies it.
+     */
+    uint32_t view_offset;
+    volatile uint32_t view_target;
+
+    uint16_t vga_base;
+    uint16_t vga_origin;
+    /* Scrolls applied to the shadow buffer but not yet to the VGA window. */
+    uint16_t pending_scroll;
+
+    /* Current cursor position and current drawing colours (fg/bg). */
+    uint16_t cursor_x;
+    uint16_t cursor_y;
+    uint8_t current_fg;
+    uint8_t current_bg;
+
+    /* Highlighted cells [sel_start, sel_end] (screen indices) and the
+     * attribute each of them had before it was highlighted. `sel_anchor`
+     * is the fixed end that framebuffer_extend_selection() drags from.
+     */
+    uint8_t sel_saved[FB_MAX_CELLS];
+    uint16_t sel_anchor;
+    uint16_t sel_start;
+    uint16_t sel_end;
+    uint8_t sel_active;
+
+    /* Escape sequence being parsed (`esc_count` parameters so far) and
+     * the cursor/colours saved by ESC[s or ESC 7.
+     */
+    uint8_t esc_state;
+    uint8_t esc_count;
+    uint16_t esc_params[FB_ANSI_MAX_PARAMS];
+    uint16_t saved_x;
+    uint16_t saved_y;
+    uint8_t saved_fg;
+    uint8_t saved_bg;
+} fb_console_t;
+
+static fb_console_t consoles[FB_NUM_CONSOLES];
+
+/* `con` receives output (put_char and friends); `shown` is on screen.
+ * Switching the displayed console only reprograms the CRTC start address:
+ * every console's page is kept up to date by fb_flush().
+ */
+static fb_console_t *con = &consoles[0];
+static uint8_t shown = 0;
+static volatile uint8_t show_target = 0;
+
+/* Cursor position last written to the VGA cursor registers (0xFFFF forces
+ * the first flush to program them).
+ */
+static uint16_t hw_cursor_pos = 0xFFFF;
+
+/* Non-zero while a public function is modifying the shadow buffer; the
+ * timer-driven flush (fb_tick) skips that tick instead of copying a
+ * half-updated row.
+ */
+static volatile uint8_t fb_busy = 0;
+
+static fb_stats_t stats;
+
+/* Receives a copy of the console output (see fb_set_mirror) */
+static fb_mirror_t mirror = 0;
 
 /* VGA port definitions used to update the hardware text cursor. */
 #define FB_COMMAND_PORT        0x3D4
 #define FB_DATA_PORT           0x3D5
 #define FB_HIGH_BYTE_COMMAND   14
 #define FB_LOW_BYTE_COMMAND    15
+#define FB_START_HIGH_COMMAND  0x0C
+#define FB_START_LOW_COMMAND   0x0D
+
+#define ROW_BIT(y)     (1ull << (y))
+#define ALL_ROWS       (ROW_BIT(fb_h) - 1u)
 
 /* Write one byte to an I/O port. This uses the `outb` instruction and
  * is marked inline so the compiler emits efficient code for port I/O.
@@ -31,247 +198,1489 @@ static inline void outb(uint16_t port, uint8_t value) {
     __asm__ __volatile__("outb %0, %1" : : "a"(value), "Nd"(port));
 }
 
+static inline uint16_t make_cell(char c, uint8_t fg, uint8_t bg) {
+    return (uint16_t)((uint8_t)c | (FB_ATTR(fg, bg) << 8));
+}
+
+/* --- Cell span primitives ---
+ * Cells are 16 bits, so one 32-bit store covers two of them. Each helper
+ * peels off a leading cell when the destination is not dword aligned,
+ * moves the bulk with `rep stosl`/`rep movsl`, then handles the odd tail.
+ */
+
+/* Store `count` copies of `cell` starting at `dst`. */
+static inline void cells_fill(uint16_t *dst, uint16_t cell, uint32_t count) {
+    if (count == 0)
+        return;
+    if ((uint32_t)dst & 2) {
+        *dst++ = cell;
+        count--;
+    }
+
+    uint32_t pair = cell | ((uint32_t)cell << 16);
+    uint32_t words = count >> 1;
+    __asm__ __volatile__("rep stosl"
+                         : "+D"(dst), "+c"(words)
+                         : "a"(pair)
+                         : "memory");
+    if (count & 1)
+        *dst = cell;
+}
+
+/* Copy `count` cells from `src` to `dst`; overlapping ranges are handled
+ * like memmove (copying downwards when `dst` lies above `src`).
+ */
+static inline void cells_move(uint16_t *dst, const uint16_t *src, uint32_t count) {
+    if (dst == src || count == 0)
+        return;
+
+    if (dst < src || dst >= src + count) {
+        if ((uint32_t)dst & 2) {
+            *dst++ = *src++;
+            count--;
+        }
+
+        uint32_t words = count >> 1;
+        __asm__ __volatile__("rep movsl"
+                             : "+D"(dst), "+S"(src), "+c"(words)
+                             :
+                             : "memory");
+        if (count & 1)
+            *dst = *src;
+        return;
+    }
+
+    /* Overlap with dst above src: walk from the end towards the start. */
+    dst += count;
+    src += count;
+    if ((uint32_t)dst & 2) {
+        *--dst = *--src;
+        count--;
+    }
+
+    uint32_t words = count >> 1;
+    if (words) {
+        uint32_t *d = (uint32_t *)dst - 1;
+        const uint32_t *sp = (const uint32_t *)src - 1;
+        __asm__ __volatile__("std\n\trep movsl\n\tcld"
+                             : "+D"(d), "+S"(sp), "+c"(words)
+                             :
+                             : "memory", "cc");
+    }
+    if (count & 1)
+        *(dst - count) = *(src - count);
+}
+
+/* Expand `count` characters into cells with attribute `attr`, two cells
+ * per 32-bit store.
+ */
+static inline void cells_store_text(uint16_t *dst, const char *str, uint32_t count, uint8_t attr) {
+    uint16_t hi = (uint16_t)attr << 8;
+
+    if (count && ((uint32_t)dst & 2)) {
+        *dst++ = hi | (uint8_t)*str++;
+        count--;
+    }
+
+    uint32_t hi2 = ((uint32_t)hi << 16) | hi;
+    uint32_t *d = (uint32_t *)dst;
+    for (; count >= 2; count -= 2, str += 2)
+        *d++ = hi2 | (uint8_t)str[0] | ((uint32_t)(uint8_t)str[1] << 16);
+
+    if (count)
+        *(uint16_t *)d = hi | (uint8_t)*str;
+}
+
+/* Replace the attribute byte of `count` cells, keeping the characters. */
+static inline void cells_set_attr(uint16_t *dst, uint32_t count, uint8_t attr) {
+    uint16_t hi = (uint16_t)attr << 8;
+
+    if (count && ((uint32_t)dst & 2)) {
+        *dst = (*dst & 0x00FF) | hi;
+        dst++;
+        count--;
+    }
+
+    uint32_t hi2 = ((uint32_t)hi << 16) | hi;
+    uint32_t *d = (uint32_t *)dst;
+    for (; count >= 2; count -= 2, d++)
+        *d = (*d & 0x00FF00FFu) | hi2;
+
+    if (count)
+        *(uint16_t *)d = (*(uint16_t *)d & 0x00FF) | hi;
+}
+
+/* Mark the rows covering cells [first, first + count) as dirty. */
+static inline void mark_cells_dirty(uint32_t first, uint32_t count) {
+    if (count == 0)
+        return;
+    uint32_t y0 = first / fb_w;
+    uint32_t y1 = (first + count - 1) / fb_w;
+    con->dirty_rows |= ((ROW_BIT(y1) - 1u) | ROW_BIT(y1)) & ~(ROW_BIT(y0) - 1u);
+}
+
 /* Write a single character cell at the given cell index using the
  * provided foreground/background colours.
  */
 static void write_cell(uint16_t index, char c, uint8_t fg, uint8_t bg) {
-    uint8_t attr = (bg << 4) | (fg & 0x0F);
-    framebuffer[2 * index]     = (uint8_t)c;
-    framebuffer[2 * index + 1] = attr;
+    con->shadow[index] = make_cell(c, fg, bg);
+    con->dirty_rows |= ROW_BIT(index / fb_w);
 }
 
-/* Update the VGA hardware cursor to match the software cursor
- * position stored in `cursor_x`/`cursor_y`.
+/* Update the VGA hardware cursor to match the software cursor of the
+ * displayed console. Skipped when the hardware already points at the same
+ * cell.
  */
-static void update_cursor(void) {
-    uint16_t pos = cursor_y * FRAMEBUFFER_WIDTH + cursor_x;
+static inline uint16_t cursor_vga_pos(const fb_console_t *c) {
+    return (uint16_t)(c->vga_base + c->vga_origin + c->cursor_y * fb_w + c->cursor_x);
+}
+
+static void update_cursor(const fb_console_t *c) {
+    uint16_t pos = cursor_vga_pos(c);
+    if (pos == hw_cursor_pos)
+        return;
 
     outb(FB_COMMAND_PORT, FB_HIGH_BYTE_COMMAND);
     outb(FB_DATA_PORT, (pos >> 8) & 0xFF);
 
     outb(FB_COMMAND_PORT, FB_LOW_BYTE_COMMAND);
     outb(FB_DATA_PORT, pos & 0xFF);
+
+    hw_cursor_pos = pos;
+    stats.cursor_syncs++;
+}
+
+/* Point the CRTC at the visible screen of console `c`. This is all it
+ * takes to display a console or scroll it.
+ */
+static void update_start_address(const fb_console_t *c) {
+    uint16_t start = c->vga_base + c->vga_origin;
+    if (start == hw_origin)
+        return;
+
+    outb(FB_COMMAND_PORT, FB_START_HIGH_COMMAND);
+    outb(FB_DATA_PORT, (start >> 8) & 0xFF);
+
+    outb(FB_COMMAND_PORT, FB_START_LOW_COMMAND);
+    outb(FB_DATA_PORT, start & 0xFF);
+
+    hw_origin = start;
+}
+
+/* Apply the scrolls accumulated since the last flush to the VGA window.
+ * Rows already on screen move with the window, so only the rows revealed
+ * at the bottom (already marked dirty) need copying - unless the window
+ * runs off the end of the console's VGA page, in which case it restarts
+ * at the page start and the whole screen is rewritten once.
+ */
+static void apply_pending_scroll(fb_console_t *c) {
+    if (c->pending_scroll == 0)
+        return;
+
+    uint32_t next = c->vga_origin + (uint32_t)c->pending_scroll * fb_w;
+    if (c->pending_scroll >= fb_h || next + fb_cells > vga_page_cells) {
+        next = 0;
+        c->dirty_rows = ALL_ROWS;
+        stats.ring_wraps++;
+    }
+
+    stats.hw_scrolls += c->pending_scroll;
+    lfb_scrolled += c->pending_scroll;
+    c->pending_scroll = 0;
+    c->vga_origin = (uint16_t)next;
+}
+
+/* Address of the line `back` lines above the top of the live screen in
+ * the scrollback ring (1 = most recent line scrolled off).
+ */
+static inline uint16_t *history_line(fb_console_t *c, uint32_t back) {
+    uint32_t slot = (c->hist_head + FB_SCROLLBACK_LINES - back) % FB_SCROLLBACK_LINES;
+    return c->history + slot * FB_MAX_WIDTH;
+}
+
+static inline uint16_t *vga_screen(const fb_console_t *c) {
+    return (uint16_t *)framebuffer + c->vga_base + c->vga_origin;
+}
+
+/* Append one screen row to the scrollback ring, padded with blanks to
+ * FB_MAX_WIDTH so it can be shown in any mode.
+ */
+static void history_push(fb_console_t *c, const uint16_t *row) {
+    uint16_t *dst = c->history + c->hist_head * FB_MAX_WIDTH;
+
+    cells_move(dst, row, fb_w);
+    if (fb_w < FB_MAX_WIDTH)
+        cells_fill(dst + fb_w, make_cell(' ', c->current_fg, c->current_bg), FB_MAX_WIDTH - fb_w);
+
+    c->hist_head = (c->hist_head + 1) % FB_SCROLLBACK_LINES;
+    if (c->hist_count < FB_SCROLLBACK_LINES)
+        c->hist_count++;
+}
+
+/* Paint the screen `view_offset` lines back: the oldest rows come from the
+ * scrollback ring, the remainder from the top of the live shadow screen.
+ */
+static void render_view(fb_console_t *c) {
+    for (uint32_t y = 0; y < fb_h; y++) {
+        const uint16_t *src;
+        if (y < c->view_offset)
+            src = history_line(c, c->view_offset - y);
+        else
+            src = c->shadow + (y - c->view_offset) * fb_w;
+
+        cells_move(vga_screen(c) + y * fb_w, src, fb_w);
+    }
+    stats.cells_flushed += fb_cells;
+}
+
+/* Switch between the live screen and the scrollback view. New output while
+ * looking at history snaps back to the live screen first.
+ */
+static void apply_view(fb_console_t *c) {
+    if (c->view_offset != 0 && (c->dirty_rows != 0 || c->pending_scroll != 0))
+        c->view_target = 0;
+
+    uint32_t target = c->view_target;
+    if (target == c->view_offset)
+        return;
+
+    c->view_offset = target;
+    if (c->view_offset == 0)
+        c->dirty_rows = ALL_ROWS;
+    else
+        render_view(c);
+}
+
+/* Bring one console's VGA page up to date with its shadow buffer. */
+static void flush_console(fb_console_t *c) {
+    apply_view(c);
+    apply_pending_scroll(c);
+
+    uint64_t rows = c->dirty_rows;
+    if (rows == 0)
+        return;
+
+    c->dirty_rows = 0;
+    stats.flushes++;
+
+    /* Runs of adjacent dirty rows are contiguous in both buffers, so
+     * each run goes out as a single block copy.
+     */
+    uint16_t y = 0;
+    while (y < fb_h) {
+        if (!(rows & ROW_BIT(y))) {
+            y++;
+            continue;
+        }
+
+        uint16_t first = y;
+        while (y < fb_h && (rows & ROW_BIT(y)))
+            y++;
+
+        uint32_t base = (uint32_t)first * fb_w;
+        uint32_t count = (uint32_t)(y - first) * fb_w;
+        cells_move(vga_screen(c) + base, c->shadow + base, count);
+        stats.cells_flushed += count;
+    }
+}
+
+static inline int console_needs_flush(const fb_console_t *c) {
+    return c->dirty_rows != 0 || c->pending_scroll != 0 || c->view_target != c->view_offset;
+}
+
+/* Consoles whose VGA memory is kept up to date: all of them with per-console
+ * pages, only the displayed one when the page is shared.
+ */
+static inline int console_on_vga(uint8_t i) {
+    return !vga_shared || i == shown;
+}
+
+/* Hand the shared VGA page to console `c`: repaint its live screen from
+ * the start of VGA memory.
+ */
+static void claim_vga(fb_console_t *c) {
+    c->vga_origin = 0;
+    c->pending_scroll = 0;
+    c->view_offset = 0;
+    c->view_target = 0;
+    c->dirty_rows = ALL_ROWS;
+}
+
+/* Give every console its VGA page for the current geometry and schedule a
+ * full repaint of each.
+ */
+static void layout_vga_pages(void) {
+    vga_shared = lfb_active || (2u * fb_cells > VGA_PAGES_CELLS / FB_NUM_CONSOLES);
+    vga_page_cells = vga_shared ? VGA_PAGES_CELLS : VGA_PAGES_CELLS / FB_NUM_CONSOLES;
+
+    for (uint8_t i = 0; i < FB_NUM_CONSOLES; i++) {
+        fb_console_t *c = &consoles[i];
+        claim_vga(c);
+        c->vga_base = (uint16_t)(STATUS_VGA_CELLS + (vga_shared ? 0 : i * vga_page_cells));
+    }
+
+    for (uint16_t x = 0; x < FB_MAX_WIDTH; x++)
+        status_shown[x] = 0;
+    status_dirty = 1;
+
+    hw_origin = 0xFFFF;
+    hw_cursor_pos = 0xFFFF;
+    pointer_at = POINTER_NONE;
+}
+
+/* Split the screen below the console rows (or undo the split) by
+ * programming the line compare register with the last scan line of the
+ * console area. The linear framebuffer does the same split in software.
+ */
+static void apply_split(void) {
+    if (lfb_active)
+        return;
+
+    uint16_t line = 0x3FF;
+    if (status_on)
+        line = (uint16_t)(fb_h * vga_mode_info(fb_mode)->char_height - 1);
+    vga_set_line_compare(line);
+}
+
+/* Copy the status cells that changed since the last flush to VGA address 0.
+ * The flag is cleared first, so a concurrent fb_status_set() is picked up
+ * by the next flush.
+ */
+static void flush_status(void) {
+    if (!status_dirty)
+        return;
+    status_dirty = 0;
+    if (!status_on)
+        return;
+
+    for (uint16_t x = 0; x < fb_w; x++) {
+        uint16_t cell = status_cells[x];
+        if (cell != status_shown[x]) {
+            framebuffer[x] = cell;
+            status_shown[x] = cell;
+            stats.cells_flushed++;
+        }
+    }
+}
+
+/* Draw the displayed screen on the linear framebuffer. The cursor is hidden
+ * while looking at scrollback.
+ */
+static void present_lfb(const fb_console_t *c) {
+    uint16_t cursor = (c->view_offset == 0) ? (uint16_t)(c->cursor_y * fb_w + c->cursor_x) : 0xFFFF;
+
+    lfb_present(vga_screen(c), fb_h, (const uint16_t *)framebuffer, lfb_scrolled, cursor);
+    lfb_scrolled = 0;
+    hw_origin = c->vga_base + c->vga_origin;
+    hw_cursor_pos = cursor_vga_pos(c);
+}
+
+/* Move the pointer to `pointer_target` on the displayed console. */
+static void flush_pointer(void) {
+    uint32_t t = pointer_target;
+    uint16_t at = POINTER_NONE;
+
+    pointer_drawn = t;
+    if (t != POINTER_HIDDEN) {
+        uint16_t x = (uint16_t)(t & 0xFFFF);
+        uint16_t y = (uint16_t)(t >> 16);
+        const fb_console_t *c = &consoles[shown];
+        if (x < fb_w && y < fb_h)
+            at = (uint16_t)(c->vga_base + c->vga_origin + y * fb_w + x);
+    }
+
+    if (pointer_at != POINTER_NONE && framebuffer[pointer_at] == pointer_cell) {
+        if (at == pointer_at)
+            return;
+        framebuffer[pointer_at] = pointer_cell ^ POINTER_XOR;
+    }
+
+    pointer_at = at;
+    if (at != POINTER_NONE) {
+        pointer_cell = framebuffer[at] ^ POINTER_XOR;
+        framebuffer[at] = pointer_cell;
+    }
+}
+
+static inline void fb_enter(void) { fb_busy++; }
+static inline void fb_leave(void) { fb_busy--; }
+
+/* Copy every dirty row of every console from its shadow buffer to its VGA
+ * page (only the displayed console when the page is shared), then point
+ * the CRTC at the displayed console and sync the hardware cursor once.
+ */
+void fb_flush(void) {
+    uint32_t cells = stats.cells_flushed;
+
+    TRACE_BEGIN(TRACE_FB_FLUSH, 0);
+    fb_enter();
+
+    if (show_target != shown) {
+        shown = show_target;
+        if (vga_shared)
+            claim_vga(&consoles[shown]);
+    }
+
+    for (uint8_t i = 0; i < FB_NUM_CONSOLES; i++)
+        if (console_on_vga(i))
+            flush_console(&consoles[i]);
+    flush_status();
+    flush_pointer();
+
+    if (lfb_active) {
+        present_lfb(&consoles[shown]);
+    } else {
+        update_start_address(&consoles[shown]);
+        update_cursor(&consoles[shown]);
+    }
+    fb_leave();
+    TRACE_END(TRACE_FB_FLUSH, stats.cells_flushed - cells);
+}
+
+/* Timer hook: flush pending output unless the interrupted code is in the
+ * middle of updating the shadow buffer (it will flush on its own).
+ */
+void fb_tick(void) {
+    if (fb_busy != 0)
+        return;
+
+    int work = (show_target != shown) || status_dirty ||
+               (pointer_target != pointer_drawn) ||
+               (cursor_vga_pos(&consoles[shown]) != hw_cursor_pos);
+    for (uint8_t i = 0; i < FB_NUM_CONSOLES && !work; i++)
+        work = console_on_vga(i) && console_needs_flush(&consoles[i]);
+
+    if (work)
+        fb_flush();
+}
+
+int fb_driver_busy(void) {
+    return fb_busy != 0;
+}
+
+void fb_get_stats(fb_stats_t *out) {
+    *out = stats;
+}
+
+/* --- Output mirror --- */
+
+fb_mirror_t fb_set_mirror(fb_mirror_t fn) {
+    fb_mirror_t old = mirror;
+    mirror = fn;
+    return old;
+}
+
+static inline void mirror_bytes(const char *s, uint32_t len) {
+    if (mirror && len)
+        mirror(s, len);
+}
+
+/* Tell the mirror about a colour change as an SGR sequence */
+static void mirror_color(void) {
+    char seq[16];
+
+    if (!mirror)
+        return;
+    int n = k_snprintf(seq, sizeof(seq), FB_CSI "%d;%dm",
+                       FB_ANSI_FG(con->current_fg), FB_ANSI_BG(con->current_bg));
+    mirror_bytes(seq, (uint32_t)n);
 }
 
 /* Set current foreground/background colours used for subsequent writes. */
 void set_color(uint8_t fg, uint8_t bg) {
-    current_fg = fg;
-    current_bg = bg;
+    if (fg == con->current_fg && bg == con->current_bg)
+        return;
+    con->current_fg = fg;
+    con->current_bg = bg;
+
+    fb_enter();
+    mirror_color();
+    fb_leave();
+}
+
+static void set_cursor(uint16_t x, uint16_t y) {
+    if (x >= fb_w)  x = fb_w - 1;
+    if (y >= fb_h) y = fb_h - 1;
+
+    con->cursor_x = x;
+    con->cursor_y = y;
 }
 
 /* Move the cursor to a specific (x,y) location. Bounds-checking prevents
  * the cursor from being moved off-screen.
  */
 void move_cursor(uint16_t x, uint16_t y) {
-    if (x >= FRAMEBUFFER_WIDTH)  x = FRAMEBUFFER_WIDTH - 1;
-    if (y >= FRAMEBUFFER_HEIGHT) y = FRAMEBUFFER_HEIGHT - 1;
+    set_cursor(x, y);
 
-    cursor_x = x;
-    cursor_y = y;
-    update_cursor();
+    if (mirror) {
+        char seq[16];
+        int n = k_snprintf(seq, sizeof(seq), FB_CSI "%u;%uH",
+                           con->cursor_y + 1u, con->cursor_x + 1u);
+        fb_enter();
+        mirror_bytes(seq, (uint32_t)n);
+        fb_leave();
+    }
 }
 
 /* Clear the entire screen by writing spaces using the current colours and
  * reset the cursor to the top-left corner.
  */
 void clear_screen(void) {
-    uint16_t i;
-    for (i = 0; i < FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT; i++) {
-        write_cell(i, ' ', current_fg, current_bg);
-    }
+    uint16_t blank = make_cell(' ', con->current_fg, con->current_bg);
+
+    fb_enter();
+    cells_fill(con->shadow, blank, fb_cells);
+    con->dirty_rows = ALL_ROWS;
+    con->sel_active = 0;
 
-    cursor_x = 0;
-    cursor_y = 0;
-    update_cursor();
+    con->cursor_x = 0;
+    con->cursor_y = 0;
+    mirror_bytes(FB_ANSI_CLEAR, sizeof(FB_ANSI_CLEAR) - 1);
+    fb_leave();
 }
 
 /* Initialise the framebuffer state to defaults and clear the screen. */
 void init_framebuffer(void) {
-    current_fg = FRAMEBUFFER_COLOR_LIGHT_GREY;
-    current_bg = FRAMEBUFFER_COLOR_BLACK;
-    clear_screen();
+    for (uint8_t i = 0; i < FB_NUM_CONSOLES; i++) {
+        fb_console_t *c = &consoles[i];
+        c->shadow = c->shadow_buf;
+
+        con = c;
+        con->current_fg = FRAMEBUFFER_COLOR_LIGHT_GREY;
+        con->current_bg = FRAMEBUFFER_COLOR_BLACK;
+        clear_screen();
+    }
+
+    con = &consoles[0];
+    shown = show_target = 0;
+    layout_vga_pages();
+    fb_flush();
+}
+
+/* --- Text mode geometry --- */
+
+uint16_t fb_width(void)  { return fb_w; }
+uint16_t fb_height(void) { return fb_h; }
+
+/* Scratch copy of one screen while a console is re-laid out. */
+static uint16_t reflow_buf[FB_MAX_CELLS];
+
+/* Re-lay out console `c` from the current geometry to w x h. Rows are
+ * truncated or blank-padded on the right; if the cursor row would fall off
+ * the bottom, the top rows go to the scrollback ring so nothing is lost.
+ */
+static void reflow_console(fb_console_t *c, uint16_t w, uint16_t h) {
+    uint16_t used = c->cursor_y + 1;
+    uint16_t top = (used > h) ? used - h : 0;
+    uint16_t keep = fb_h - top;
+    uint16_t cols = (fb_w < w) ? fb_w : w;
+
+    if (keep > h)
+        keep = h;
+
+    for (uint16_t y = 0; y < top; y++)
+        history_push(c, c->shadow + y * fb_w);
+
+    cells_move(reflow_buf, c->shadow, fb_cells);
+    c->shadow = c->shadow_buf;
+    cells_fill(c->shadow, make_cell(' ', c->current_fg, c->current_bg), (uint32_t)w * h);
+    for (uint16_t y = 0; y < keep; y++)
+        cells_move(c->shadow + y * w, reflow_buf + (top + y) * fb_w, cols);
+
+    c->cursor_y -= top;
+    if (c->cursor_x >= w)
+        c->cursor_x = w - 1;
+}
+
+/* Re-lay out every console for a cols x rows screen (less the status
+ * line) and repaint.
+ */
+static void set_geometry(uint16_t cols, uint16_t rows) {
+    uint16_t h = rows - status_on;
+
+    fb_console_t *out = con;
+    for (uint8_t i = 0; i < FB_NUM_CONSOLES; i++) {
+        con = &consoles[i];
+        framebuffer_clear_selection();
+        reflow_console(con, cols, h);
+    }
+    con = out;
+
+    fb_w = cols;
+    fb_h = h;
+    scr_h = rows;
+    fb_cells = (uint16_t)(cols * h);
+    layout_vga_pages();
+    apply_split();
+}
+
+/* Switch the display to a cols x rows text mode (80x25, 80x50 or 90x60).
+ * Every console keeps its text, cursor and scrollback. Returns 0 on
+ * success, -1 if the geometry is not supported. Main context only.
+ */
+int fb_set_mode(uint16_t cols, uint16_t rows) {
+    vga_text_mode_t mode = VGA_MODE_COUNT;
+    for (int m = 0; m < VGA_MODE_COUNT; m++) {
+        const vga_mode_info_t *info = vga_mode_info((vga_text_mode_t)m);
+        if (info->cols == cols && info->rows == rows)
+            mode = (vga_text_mode_t)m;
+    }
+    if (mode == VGA_MODE_COUNT || cols > FB_MAX_WIDTH || rows > FB_MAX_HEIGHT || lfb_active)
+        return -1;
+    if (mode == fb_mode)
+        return 0;
+
+    fb_enter();
+    vga_set_text_mode(mode);
+    fb_mode = mode;
+    set_geometry(cols, rows);
+    fb_leave();
+
+    fb_flush();
+    return 0;
 }
 
-/* Scroll the buffer up one line when the cursor moves past the bottom of
- * the screen. This performs a simple memcopy-by-cell to move lines up and
- * clears the last line.
+/* Send all output to the linear-framebuffer console with a cols x rows
+ * cell grid. lfb_init() must have succeeded; call before init_framebuffer().
+ * The VGA text hardware is never touched afterwards, so fb_set_mode() is
+ * unavailable.
+ */
+void fb_attach_lfb(uint16_t cols, uint16_t rows) {
+    if (cols > FB_MAX_WIDTH) cols = FB_MAX_WIDTH;
+    if (rows > FB_MAX_HEIGHT) rows = FB_MAX_HEIGHT;
+
+    framebuffer = lfb_text;
+    lfb_active = 1;
+    fb_w = cols;
+    fb_h = rows;
+    scr_h = rows;
+    fb_cells = (uint16_t)(cols * rows);
+}
+
+/* --- Status line --- */
+
+/* Give the bottom screen row to the status line (on) or back to the
+ * consoles (off). The consoles are re-laid out one row shorter or taller,
+ * so scrolling and clearing stay above the status line. Main context only.
+ */
+void fb_status_enable(int on) {
+    on = on ? 1 : 0;
+    if (on == status_on)
+        return;
+
+    fb_enter();
+    status_on = (uint8_t)on;
+    set_geometry(fb_w, scr_h);
+    fb_leave();
+
+    fb_flush();
+}
+
+/* Replace the status line with `text` in colour `attr`, blank-padded to
+ * the screen width. Only touches the status row, so it is IRQ-safe; the
+ * changed cells reach the screen with the next flush.
+ */
+void fb_status_set(const char *text, uint8_t attr) {
+    uint16_t hi = (uint16_t)attr << 8;
+    uint16_t x = 0;
+
+    for (; x < fb_w && text[x]; x++)
+        status_cells[x] = hi | (uint8_t)text[x];
+    for (; x < fb_w; x++)
+        status_cells[x] = hi | ' ';
+    status_dirty = 1;
+}
+
+/* --- Virtual consoles --- */
+
+/* Route subsequent output (put_char, write_str, clear_screen, ...) to
+ * console `n`. Main context only.
+ */
+void fb_console_select(uint8_t n) {
+    if (n < FB_NUM_CONSOLES)
+        con = &consoles[n];
+}
+
+uint8_t fb_console_current(void) {
+    return (uint8_t)(con - consoles);
+}
+
+/* Display console `n`. Only records the request, so it is safe from IRQ
+ * context; the next flush reprograms the CRTC start address (no copy).
+ */
+void fb_console_show(uint8_t n) {
+    if (n < FB_NUM_CONSOLES)
+        show_target = n;
+}
+
+uint8_t fb_console_shown(void) {
+    return show_target;
+}
+
+/* Scroll up one line when the cursor moves past the bottom of the screen.
+ * The top row is saved to the scrollback ring, then the shadow window
+ * slides down one row (compacting back to the start of shadow_buf when it
+ * reaches the end) and the new bottom row is cleared.
+ * Dirty bits follow their rows; the VGA side is caught up by the next
+ * fb_flush() via the CRTC start address.
  */
 static void scroll_if_needed(void) {
-    if (cursor_y < FRAMEBUFFER_HEIGHT)
+    if (con->cursor_y < fb_h)
         return;
 
-    uint16_t x, y;
+    /* The selection's screen indices are about to go stale; put the
+     * original colours back (so history keeps them) and drop it.
+     */
+    framebuffer_clear_selection();
 
-    for (y = 1; y < FRAMEBUFFER_HEIGHT; y++) {
-        for (x = 0; x < FRAMEBUFFER_WIDTH; x++) {
-            uint16_t from = y * FRAMEBUFFER_WIDTH + x;
-            uint16_t to   = (y - 1) * FRAMEBUFFER_WIDTH + x;
+    history_push(con, con->shadow);
 
-            framebuffer[2 * to]     = framebuffer[2 * from];
-            framebuffer[2 * to + 1] = framebuffer[2 * from + 1];
-        }
+    if (con->shadow + fb_cells + fb_w > con->shadow_buf + sizeof(con->shadow_buf) / sizeof(con->shadow_buf[0])) {
+        cells_move(con->shadow_buf, con->shadow + fb_w, fb_cells - fb_w);
+        con->shadow = con->shadow_buf;
+    } else {
+        con->shadow += fb_w;
     }
 
     /* Clear the last line after shifting everything up. */
-    for (x = 0; x < FRAMEBUFFER_WIDTH; x++) {
-        uint16_t index = (FRAMEBUFFER_HEIGHT - 1) * FRAMEBUFFER_WIDTH + x;
-        write_cell(index, ' ', current_fg, current_bg);
+    cells_fill(con->shadow + fb_cells - fb_w,
+               make_cell(' ', con->current_fg, con->current_bg), fb_w);
+    con->dirty_rows = (con->dirty_rows >> 1) | ROW_BIT(fb_h - 1);
+    con->pending_scroll++;
+
+    con->cursor_y = fb_h - 1;
+}
+
+/* --- ANSI escape sequences ---
+ * A small VT100-style state machine run by put_char: ESC moves to
+ * ESC_START, '[' to ESC_CSI, which collects ';'-separated decimal
+ * parameters until a final byte (0x40..0x7E) selects the command.
+ * Unsupported sequences are parsed and dropped, so they never print.
+ * The state is per console, so a sequence may span several writes.
+ */
+enum { ESC_NONE, ESC_START, ESC_CSI };
+
+/* ANSI colour numbers order the RGB bits the other way round from VGA
+ * attributes (1 = red vs 1 = blue); swapping bits 0 and 2 converts
+ * either way.
+ */
+static inline uint8_t ansi_color(uint16_t n) {
+    return (uint8_t)(((n & 1) << 2) | (n & 2) | ((n >> 2) & 1));
+}
+
+/* Parameter i, or `def` when it was omitted or zero. */
+static inline uint16_t esc_param(const fb_console_t *c, uint8_t i, uint16_t def) {
+    return (i < c->esc_count && c->esc_params[i]) ? c->esc_params[i] : def;
+}
+
+/* Blank cells [first, first + count) of the current console. */
+static void erase_cells(uint32_t first, uint32_t count) {
+    framebuffer_clear_selection();
+    cells_fill(con->shadow + first, make_cell(' ', con->current_fg, con->current_bg), count);
+    mark_cells_dirty(first, count);
+}
+
+/* SGR (ESC[...m): 0 reset, 1/22 bright/normal foreground, 30-37 and
+ * 90-97 foreground, 40-47 and 100-107 background, 39/49 default colours.
+ */
+static void ansi_sgr(void) {
+    if (con->esc_count == 0)
+        con->esc_count = 1;
+
+    for (uint8_t i = 0; i < con->esc_count; i++) {
+        uint16_t n = con->esc_params[i];
+
+        if (n == 0) {
+            con->current_fg = FRAMEBUFFER_COLOR_LIGHT_GREY;
+            con->current_bg = FRAMEBUFFER_COLOR_BLACK;
+        } else if (n == 1) {
+            con->current_fg |= 8;
+        } else if (n == 22) {
+            con->current_fg &= 7;
+        } else if (n >= 30 && n <= 37) {
+            con->current_fg = (uint8_t)((con->current_fg & 8) | ansi_color(n - 30));
+        } else if (n == 39) {
+            con->current_fg = FRAMEBUFFER_COLOR_LIGHT_GREY;
+        } else if (n >= 40 && n <= 47) {
+            con->current_bg = ansi_color(n - 40);
+        } else if (n == 49) {
+            con->current_bg = FRAMEBUFFER_COLOR_BLACK;
+        } else if (n >= 90 && n <= 97) {
+            con->current_fg = (uint8_t)(8 | ansi_color(n - 90));
+        } else if (n >= 100 && n <= 107) {
+            con->current_bg = (uint8_t)(8 | ansi_color(n - 100));
+        }
+    }
+}
+
+static void ansi_save_cursor(void) {
+    con->saved_x = con->cursor_x;
+    con->saved_y = con->cursor_y;
+    con->saved_fg = con->current_fg;
+    con->saved_bg = con->current_bg;
+}
+
+static void ansi_restore_cursor(int with_colors) {
+    set_cursor(con->saved_x, con->saved_y);
+    if (with_colors) {
+        con->current_fg = con->saved_fg;
+        con->current_bg = con->saved_bg;
+    }
+}
+
+/* Execute a complete control sequence ESC[<params><final>. */
+static void ansi_csi(char final) {
+    uint16_t n = esc_param(con, 0, 1);
+    uint16_t x = con->cursor_x;
+    uint16_t y = con->cursor_y;
+    uint32_t here = (uint32_t)y * fb_w + x;
+
+    switch (final) {
+    case 'H':
+    case 'f':
+        set_cursor((uint16_t)(esc_param(con, 1, 1) - 1), (uint16_t)(n - 1));
+        break;
+    case 'A':
+        set_cursor(x, (n > y) ? 0 : (uint16_t)(y - n));
+        break;
+    case 'B':
+        set_cursor(x, (n >= fb_h - y) ? fb_h - 1 : (uint16_t)(y + n));
+        break;
+    case 'C':
+        set_cursor((n >= fb_w - x) ? fb_w - 1 : (uint16_t)(x + n), y);
+        break;
+    case 'D':
+        set_cursor((n > x) ? 0 : (uint16_t)(x - n), y);
+        break;
+    case 'G':
+        set_cursor((uint16_t)(n - 1), y);
+        break;
+    case 'J':
+        switch (esc_param(con, 0, 0)) {
+        case 0: erase_cells(here, fb_cells - here); break;
+        case 1: erase_cells(0, here + 1); break;
+        case 2: erase_cells(0, fb_cells); break;
+        }
+        break;
+    case 'K':
+        switch (esc_param(con, 0, 0)) {
+        case 0: erase_cells(here, fb_w - x); break;
+        case 1: erase_cells(here - x, x + 1u); break;
+        case 2: erase_cells(here - x, fb_w); break;
+        }
+        break;
+    case 'm':
+        ansi_sgr();
+        break;
+    case 's':
+        ansi_save_cursor();
+        break;
+    case 'u':
+        ansi_restore_cursor(0);
+        break;
+    }
+}
+
+/* Feed one byte of an escape sequence (the ESC itself included). */
+static void ansi_feed(char c) {
+    if (c == '\x1B') {
+        con->esc_state = ESC_START;
+        return;
     }
 
-    cursor_y = FRAMEBUFFER_HEIGHT - 1;
+    if (con->esc_state == ESC_START) {
+        con->esc_state = ESC_NONE;
+        if (c == '[') {
+            con->esc_state = ESC_CSI;
+            con->esc_count = 0;
+            con->esc_params[0] = 0;
+        } else if (c == '7') {
+            ansi_save_cursor();
+        } else if (c == '8') {
+            ansi_restore_cursor(1);
+        }
+        return;
+    }
+
+    /* ESC_CSI */
+    if (c >= '0' && c <= '9') {
+        if (con->esc_count == 0)
+            con->esc_count = 1;
+        uint16_t *p = &con->esc_params[con->esc_count - 1];
+        if (*p < 1000)
+            *p = (uint16_t)(*p * 10 + (c - '0'));
+    } else if (c == ';') {
+        if (con->esc_count == 0)
+            con->esc_count = 1;
+        if (con->esc_count < FB_ANSI_MAX_PARAMS)
+            con->esc_params[con->esc_count++] = 0;
+    } else if (c >= 0x40 && c <= 0x7E) {
+        con->esc_state = ESC_NONE;
+        ansi_csi(c);
+    } else if (c < 0x20 || c > 0x3F) {
+        /* Not part of a control sequence: abandon it. '?' and the other
+         * private/intermediate bytes are accepted and ignored.
+         */
+        con->esc_state = ESC_NONE;
+    }
 }
 
 /* Output a single character. Newlines move the cursor to the start of the
- * next line. After writing we advance the cursor and update the hardware
- * cursor; scrolling is performed if necessary.
+ * next line and '\r' to the start of the current one; ESC starts an ANSI
+ * escape sequence (see above). After writing we advance the cursor;
+ * scrolling is performed if necessary. The screen itself is only updated
+ * by the next fb_flush().
  */
-void put_char(char c) {
+static void console_put_char(char c) {
+    fb_enter();
+
+    if (c == '\x1B' || con->esc_state != ESC_NONE) {
+        ansi_feed(c);
+        fb_leave();
+        return;
+    }
+
+    if (c == '\r') {
+        con->cursor_x = 0;
+        fb_leave();
+        return;
+    }
+
     if (c == '\b') {
-        if (cursor_x > 0) {
-            cursor_x--;
-        } else if (cursor_y > 0) {
-            cursor_y--;
-            cursor_x = FRAMEBUFFER_WIDTH - 1;
+        if (con->cursor_x > 0) {
+            con->cursor_x--;
+        } else if (con->cursor_y > 0) {
+            con->cursor_y--;
+            con->cursor_x = fb_w - 1;
         }
         
-        uint16_t index = cursor_y * FRAMEBUFFER_WIDTH + cursor_x;
-        write_cell(index, ' ', current_fg, current_bg);
-        update_cursor();
+        uint16_t index = con->cursor_y * fb_w + con->cursor_x;
+        write_cell(index, ' ', con->current_fg, con->current_bg);
+        fb_leave();
         return;
     }
 
     if (c == '\n') {
-        cursor_x = 0;
-        cursor_y++;
+        con->cursor_x = 0;
+        con->cursor_y++;
         scroll_if_needed();
-        update_cursor();
+        fb_leave();
         return;
     }
 
-    uint16_t index = cursor_y * FRAMEBUFFER_WIDTH + cursor_x;
-    write_cell(index, c, current_fg, current_bg);
+    uint16_t index = con->cursor_y * fb_w + con->cursor_x;
+    write_cell(index, c, con->current_fg, con->current_bg);
 
-    cursor_x++;
-    if (cursor_x >= FRAMEBUFFER_WIDTH) {
-        cursor_x = 0;
-        cursor_y++;
+    con->cursor_x++;
+    if (con->cursor_x >= fb_w) {
+        con->cursor_x = 0;
+        con->cursor_y++;
     }
 
     scroll_if_needed();
-    update_cursor();
+    fb_leave();
+}
+
+void put_char(char c) {
+    fb_enter();
+    mirror_bytes(&c, 1);
+    console_put_char(c);
+    fb_leave();
+}
+
+/* Write len bytes, then flush them to the screen in one go.
+ * Runs of printable characters go through fb_write_run; only control
+ * characters and escape sequences take the per-character put_char path
+ * (a sequence may be split across calls). FB_COLOR_ESC followed
+ * by a hex digit switches the foreground colour, followed by '*' restores
+ * the colour this call started with. The mirror gets the bytes as
+ * written, with colour escapes turned into SGR sequences.
+ */
+void fb_write_buf(const char *s, uint32_t len) {
+    const char *end = s + len;
+    uint8_t start_fg = con->current_fg;
+
+    fb_enter();
+    while (s < end) {
+        if (con->esc_state != ESC_NONE) {
+            mirror_bytes(s, 1);
+            console_put_char(*s++);
+            continue;
+        }
+        const char *run = s;
+        while (s < end && *s != '\n' && *s != '\b' && *s != '\r' &&
+               *s != '\x1B' && *s != FB_COLOR_ESC)
+            s++;
+        while (run < s) {
+            uint32_t n = (uint32_t)(s - run);
+            if (n > 0xFFFF) n = 0xFFFF;
+            fb_write_run(run, (uint16_t)n, FB_ATTR(con->current_fg, con->current_bg));
+            run += n;
+        }
+        if (s >= end)
+            break;
+        if (*s == FB_COLOR_ESC) {
+            if (++s >= end)
+                break;
+            char d = *s++;
+            if (d >= '0' && d <= '9') con->current_fg = (uint8_t)(d - '0');
+            else if (d >= 'a' && d <= 'f') con->current_fg = (uint8_t)(d - 'a' + 10);
+            else if (d == '*') con->current_fg = start_fg;
+            mirror_color();
+            continue;
+        }
+        mirror_bytes(s, 1);
+        console_put_char(*s++);
+    }
+    fb_leave();
+    fb_flush();
 }
 
-/* Write a NUL-terminated string by repeatedly calling put_char. */
+/* Write a NUL-terminated string (see fb_write_buf). */
 void write_str(const char *s) {
-    while (*s)
-        put_char(*s++);
+    uint32_t len = 0;
+    while (s[len])
+        len++;
+    fb_write_buf(s, len);
 }
 
-/* Write a signed decimal integer. Uses a small buffer to build the digits
- * in reverse order then emits them in the correct order. Zero is handled
- * as a special case.
+/* --- Span API --- */
+
+uint8_t fb_current_attr(void) {
+    return FB_ATTR(con->current_fg, con->current_bg);
+}
+
+/* Fill `count` cells starting at (x,y), continuing onto following rows and
+ * clipped at the end of the screen. The cursor is not moved.
  */
-void write_dec(int value) {
-    char buf[16];
-    int i = 0;
-    int neg = 0;
+void fb_fill_cells(uint16_t x, uint16_t y, uint16_t count, char c, uint8_t attr) {
+    if (x >= fb_w || y >= fb_h)
+        return;
+
+    uint32_t start = (uint32_t)y * fb_w + x;
+    if (count > fb_cells - start)
+        count = (uint16_t)(fb_cells - start);
+
+    fb_enter();
+    cells_fill(con->shadow + start, (uint16_t)((uint8_t)c | (attr << 8)), count);
+    mark_cells_dirty(start, count);
+    fb_leave();
+}
+
+/* Fill a w x h rectangle whose top-left corner is (x,y), clipped to the
+ * screen. The cursor is not moved.
+ */
+void fb_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, char c, uint8_t attr) {
+    if (x >= fb_w || y >= fb_h)
+        return;
+    if (w > fb_w - x)  w = fb_w - x;
+    if (h > fb_h - y) h = fb_h - y;
+    if (w == 0 || h == 0)
+        return;
+
+    uint16_t cell = (uint16_t)((uint8_t)c | (attr << 8));
 
-    if (value == 0) {
-        put_char('0');
+    fb_enter();
+    if (w == fb_w) {
+        /* Full-width rectangles are one contiguous span. */
+        cells_fill(con->shadow + y * fb_w, cell, (uint32_t)h * fb_w);
+    } else {
+        for (uint16_t row = y; row < y + h; row++)
+            cells_fill(con->shadow + row * fb_w + x, cell, w);
+    }
+    mark_cells_dirty((uint32_t)y * fb_w, (uint32_t)h * fb_w);
+    fb_leave();
+}
+
+/* Copy `count` cells from (src_x,src_y) to (dst_x,dst_y) in linear screen
+ * order; overlapping spans are safe. Both spans are clipped to the screen.
+ */
+void fb_blit_cells(uint16_t dst_x, uint16_t dst_y, uint16_t src_x, uint16_t src_y, uint16_t count) {
+    if (dst_x >= fb_w || dst_y >= fb_h ||
+        src_x >= fb_w || src_y >= fb_h)
         return;
+
+    uint32_t dst = (uint32_t)dst_y * fb_w + dst_x;
+    uint32_t src = (uint32_t)src_y * fb_w + src_x;
+    uint32_t limit = fb_cells - (dst > src ? dst : src);
+    if (count > limit)
+        count = (uint16_t)limit;
+
+    fb_enter();
+    cells_move(con->shadow + dst, con->shadow + src, count);
+    mark_cells_dirty(dst, count);
+    fb_leave();
+}
+
+/* Write `len` characters at the cursor with attribute `attr`, advancing
+ * the cursor, wrapping and scrolling like put_char. Characters are stored
+ * verbatim (no '\n' / '\b' handling), one row-sized span at a time.
+ */
+void fb_write_run(const char *str, uint16_t len, uint8_t attr) {
+    fb_enter();
+    mirror_bytes(str, len);
+    while (len > 0) {
+        uint16_t room = fb_w - con->cursor_x;
+        uint16_t n = (len < room) ? len : room;
+        uint32_t start = (uint32_t)con->cursor_y * fb_w + con->cursor_x;
+
+        cells_store_text(con->shadow + start, str, n, attr);
+        con->dirty_rows |= ROW_BIT(con->cursor_y);
+
+        str += n;
+        len -= n;
+        con->cursor_x += n;
+        if (con->cursor_x >= fb_w) {
+            con->cursor_x = 0;
+            con->cursor_y++;
+            scroll_if_needed();
+        }
     }
+    fb_leave();
+}
 
-    if (value < 0) {
-        neg = 1;
-        value = -value;
+/* Write `count` copies of `c` at the cursor (cursor-relative counterpart
+ * of fb_fill_cells), wrapping and scrolling like put_char.
+ */
+void fb_write_repeat(char c, uint16_t count, uint8_t attr) {
+    uint16_t cell = (uint16_t)((uint8_t)c | (attr << 8));
+
+    fb_enter();
+    if (mirror) {
+        char chunk[32];
+
+        for (uint16_t i = 0; i < sizeof(chunk); i++)
+            chunk[i] = c;
+        for (uint16_t left = count; left > 0; ) {
+            uint16_t n = (left < sizeof(chunk)) ? left : (uint16_t)sizeof(chunk);
+            mirror_bytes(chunk, n);
+            left -= n;
+        }
     }
-    
-    /* Build the number in reverse order in the buffer */
-    while (value > 0 && i < (int)(sizeof(buf) - 1)) {
-        buf[i++] = '0' + (value % 10);
-        value /= 10;
+    while (count > 0) {
+        uint16_t room = fb_w - con->cursor_x;
+        uint16_t n = (count < room) ? count : room;
+
+        cells_fill(con->shadow + con->cursor_y * fb_w + con->cursor_x, cell, n);
+        con->dirty_rows |= ROW_BIT(con->cursor_y);
+
+        count -= n;
+        con->cursor_x += n;
+        if (con->cursor_x >= fb_w) {
+            con->cursor_x = 0;
+            con->cursor_y++;
+            scroll_if_needed();
+        }
     }
-    
-    if (neg)
-        buf[i++] = '-';
+    fb_leave();
+}
 
-    /* Output the digits in correct order */      
-    for (int j = i - 1; j >= 0; j--)
-        put_char(buf[j]);
+/* Write a signed decimal integer (digits via the k_printf formatter). */
+void write_dec(int value) {
+    write_dec_ll(value);
 }
 
 /* Write a signed decimal long long. Safe for LLONG_MIN (avoids negation overflow). */
 void write_dec_ll(long long value) {
-    char buf[32];
-    int i = 0;
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p;
     unsigned long long u;
 
-    if (value == 0) {
-        put_char('0');
-        return;
-    }
-
     if (value < 0) {
-        put_char('-');
         /* Convert to magnitude in unsigned without overflowing on LLONG_MIN */
         u = (unsigned long long)(-(value + 1)) + 1ULL;
     } else {
         u = (unsigned long long)value;
     }
 
-    while (u > 0ULL && i < (int)(sizeof(buf) - 1)) {
-        buf[i++] = (char)('0' + (u % 10ULL));
-        u /= 10ULL;
-    }
-
-    for (int j = i - 1; j >= 0; j--)
-        put_char(buf[j]);
+    p = k_fmt_u64(end, u);
+    if (value < 0)
+        *--p = '-';
+    fb_write_run(p, (uint16_t)(end - p), FB_ATTR(con->current_fg, con->current_bg));
 }
 
-/* --- New Selection Functions --- */
+/* --- Selection ---
+ * A selection is a range of cells in screen order. Highlighting saves the
+ * original attribute of each cell it touches and clearing restores exactly
+ * those bytes, so coloured text survives. Cells written since they were
+ * highlighted no longer carry the highlight and keep what was written.
+ * Moving an existing selection only touches the cells that enter or leave it.
+ */
+
+#define SELECTION_ATTR FB_ATTR(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLUE)
 
 char framebuffer_get_char(uint16_t x, uint16_t y) {
-    if (x >= FRAMEBUFFER_WIDTH || y >= FRAMEBUFFER_HEIGHT) return 0;
-    uint16_t index = y * FRAMEBUFFER_WIDTH + x;
-    return (char)framebuffer[2 * index];
+    if (x >= fb_w || y >= fb_h) return 0;
+    uint16_t index = y * fb_w + x;
+    return (char)(con->shadow[index] & 0xFF);
+}
+
+/* Save the attributes of cells [from, to] and highlight them. */
+static void sel_apply(uint16_t from, uint16_t to) {
+    if (from > to) return;
+    for (uint16_t i = from; i <= to; i++)
+        con->sel_saved[i] = (uint8_t)(con->shadow[i] >> 8);
+    cells_set_attr(con->shadow + from, (uint32_t)(to - from + 1), SELECTION_ATTR);
+    mark_cells_dirty(from, (uint32_t)(to - from + 1));
+}
+
+/* Put back the saved attributes of cells [from, to] that still show the
+ * highlight; the others have been overwritten since.
+ */
+static void sel_restore(uint16_t from, uint16_t to) {
+    if (from > to) return;
+    for (uint16_t i = from; i <= to; i++)
+        if ((con->shadow[i] >> 8) == SELECTION_ATTR)
+            con->shadow[i] = (uint16_t)((con->shadow[i] & 0x00FF) | ((uint16_t)con->sel_saved[i] << 8));
+    mark_cells_dirty(from, (uint32_t)(to - from + 1));
+}
+
+/* Make [start, end] the selection, touching only the difference from the
+ * current one.
+ */
+static void sel_update(uint16_t start, uint16_t end) {
+    if (!con->sel_active) {
+        sel_apply(start, end);
+    } else {
+        uint16_t os = con->sel_start;
+        uint16_t oe = con->sel_end;
+
+        /* Cells leaving the selection */
+        if (start > os) sel_restore(os, (start - 1 < oe) ? start - 1 : oe);
+        if (end < oe)   sel_restore((end + 1 > os) ? end + 1 : os, oe);
+
+        /* Cells entering it */
+        if (start < os) sel_apply(start, (os - 1 < end) ? os - 1 : end);
+        if (end > oe)   sel_apply((oe + 1 > start) ? oe + 1 : start, end);
+    }
+
+    con->sel_start = start;
+    con->sel_end = end;
+    con->sel_active = 1;
 }
 
+static inline uint16_t cell_index(uint16_t x, uint16_t y) {
+    if (x >= fb_w) x = fb_w - 1;
+    if (y >= fb_h) y = fb_h - 1;
+    return (uint16_t)(y * fb_w + x);
+}
+
+/* Select the cells from (x1,y1) to (x2,y2) inclusive, in screen order.
+ * (x1,y1) becomes the anchor. If a selection already exists it is moved
+ * to the new range incrementally.
+ */
 void framebuffer_highlight_region(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
-    /* Ensure coordinates are ordered correctly (top-left to bottom-right) */
-    if (y1 > y2 || (y1 == y2 && x1 > x2)) {
-        /* Swap */
-        uint16_t tx = x1; x1 = x2; x2 = tx;
-        uint16_t ty = y1; y1 = y2; y2 = ty;
+    uint16_t a = cell_index(x1, y1);
+    uint16_t b = cell_index(x2, y2);
+
+    fb_enter();
+    con->sel_anchor = a;
+    sel_update(a < b ? a : b, a < b ? b : a);
+    fb_leave();
+}
+
+/* Move the free end of the selection to (x,y), keeping the anchor. Starts
+ * a one-cell selection at (x,y) if there is none. Only cells whose state
+ * changes are rewritten, so dragging is cheap.
+ */
+void framebuffer_extend_selection(uint16_t x, uint16_t y) {
+    uint16_t b = cell_index(x, y);
+
+    fb_enter();
+    if (!con->sel_active)
+        con->sel_anchor = b;
+    uint16_t a = con->sel_anchor;
+    sel_update(a < b ? a : b, a < b ? b : a);
+    fb_leave();
+}
+
+/* Restore the original attributes of the selected cells and drop the selection. */
+void framebuffer_clear_selection(void) {
+    if (!con->sel_active)
+        return;
+
+    fb_enter();
+    sel_restore(con->sel_start, con->sel_end);
+    con->sel_active = 0;
+    fb_leave();
+}
+
+/* Copy the selected text into `out` (NUL-terminated, at most max-1 chars).
+ * Rows are separated by '\n' with trailing spaces trimmed. Returns the
+ * number of characters stored (0 if nothing is selected).
+ */
+uint16_t framebuffer_copy_selection(char *out, uint16_t max) {
+    uint16_t n = 0;
+
+    if (max == 0)
+        return 0;
+
+    if (con->sel_active) {
+        uint16_t i = con->sel_start;
+        while (i <= con->sel_end && n + 1 < max) {
+            uint16_t y = i / fb_w;
+            uint16_t x = i % fb_w;
+            uint16_t last = (uint16_t)(y * fb_w + fb_w - 1);
+            if (last > con->sel_end) last = con->sel_end;
+
+            /* Trim trailing blanks on this row of the selection */
+            uint16_t stop = last + 1;
+            while (stop > i && framebuffer_get_char((stop - 1) % fb_w, y) == ' ')
+                stop--;
+
+            for (; i < stop && n + 1 < max; i++, x++)
+                out[n++] = framebuffer_get_char(x, y);
+
+            i = last + 1;
+            if (i <= con->sel_end && n + 1 < max)
+                out[n++] = '\n';
+        }
+    }
+
+    out[n] = '\0';
+    return n;
+}
+
+/* --- Mouse pointer --- */
+
+/* Show the pointer at cell (x,y) of the displayed console; IRQ-safe,
+ * drawn by the next flush.
+ */
+void fb_pointer_move(uint16_t x, uint16_t y) {
+    pointer_target = (uint32_t)y << 16 | x;
+}
+
+void fb_pointer_hide(void) {
+    pointer_target = POINTER_HIDDEN;
+}
+
+/* --- Scrollback --- */
+
+/* Move the displayed console's view `lines` further into history
+ * (negative = towards live output). Safe to call from IRQ context; takes effect at the next flush.
+ */
+void fb_scrollback(int lines) {
+    fb_console_t *c = &consoles[show_target];
+    int32_t target = (int32_t)c->view_target + lines;
+    if (target < 0) target = 0;
+    if ((uint32_t)target > c->hist_count) target = (int32_t)c->hist_count;
+    c->view_target = (uint32_t)target;
+}
+
+/* Number of searchable lines above the cursor row: the scrollback ring
+ * plus the on-screen rows above the cursor.
+ */
+uint32_t fb_history_lines(void) {
+    return con->hist_count + con->cursor_y;
+}
+
+/* Cells of the line `back` lines above the cursor row (1 = the row just
+ * above it), or 0 if out of range.
+ */
+static const uint16_t *line_above_cursor(uint32_t back) {
+    if (back == 0 || back > con->hist_count + con->cursor_y)
+        return 0;
+    if (back <= con->cursor_y)
+        return con->shadow + (con->cursor_y - back) * fb_w;
+    return history_line(con, back - con->cursor_y);
+}
+
+/* Index of the first cell in `p[0..n)` whose character is `c`, or -1.
+ * Works a dword (two cells) at a time: after XOR with the replicated
+ * character, a matching cell is a zero 16-bit lane, found with the usual
+ * (x - 0x0001...) & ~x & 0x8000... test.
+ */
+static int32_t cells_memchr(const uint16_t *p, uint32_t n, uint8_t c) {
+    uint32_t i = 0;
+
+    if (n && ((uint32_t)p & 2)) {
+        if ((uint8_t)p[0] == c) return 0;
+        i = 1;
+    }
+
+    const uint32_t pattern = (uint32_t)c * 0x00010001u;
+    for (; i + 2 <= n; i += 2) {
+        uint32_t x = (*(const uint32_t *)(p + i) & 0x00FF00FFu) ^ pattern;
+        if ((x - 0x00010001u) & ~x & 0x80008000u) {
+            /* A borrow out of the low lane can only flag the high lane
+             * when the low lane itself matched, so check it first.
+             */
+            return ((uint8_t)p[i] == c) ? (int32_t)i : (int32_t)(i + 1);
+        }
+    }
+
+    if (i < n && (uint8_t)p[i] == c) return (int32_t)i;
+    return -1;
+}
+
+/* Column of the first occurrence of `needle` (length `len`) in a line of
+ * cells, or -1.
+ */
+static int32_t cells_memmem(const uint16_t *line, uint32_t n, const char *needle, uint32_t len) {
+    uint32_t start = 0;
+
+    while (start + len <= n) {
+        int32_t hit = cells_memchr(line + start, n - start - len + 1, (uint8_t)needle[0]);
+        if (hit < 0)
+            return -1;
+
+        uint32_t pos = start + (uint32_t)hit;
+        uint32_t k = 1;
+        while (k < len && (uint8_t)line[pos + k] == (uint8_t)needle[k])
+            k++;
+        if (k == len)
+            return (int32_t)pos;
+
+        start = pos + 1;
     }
+    return -1;
+}
 
-    uint16_t start = y1 * FRAMEBUFFER_WIDTH + x1;
-    uint16_t end   = y2 * FRAMEBUFFER_WIDTH + x2;
+/* Search lines above the cursor for `needle`, newest first, starting at
+ * `from` lines back. On success stores the line's distance in *found and
+ * returns 1.
+ */
+int fb_history_find(const char *needle, uint32_t from, uint32_t *found) {
+    uint32_t len = 0;
+    while (needle[len]) len++;
+    if (len == 0 || len > fb_w)
+        return 0;
 
-    for (uint16_t i = start; i <= end; i++) {
-        /* Preserve existing character, change background to Blue (1) and foreground to White (15) */
-        /* Highlight style: White on Blue */
-        uint8_t attr = (FRAMEBUFFER_COLOR_BLUE << 4) | (FRAMEBUFFER_COLOR_WHITE & 0x0F);
-        framebuffer[2 * i + 1] = attr;
+    uint32_t total = fb_history_lines();
+    for (uint32_t back = (from == 0 ? 1 : from); back <= total; back++) {
+        if (cells_memmem(line_above_cursor(back), fb_w, needle, len) >= 0) {
+            *found = back;
+            return 1;
+        }
     }
+    return 0;
 }
 
-void framebuffer_clear_selection(void) {
-    /* Reset all attributes to standard Light Grey on Black */
-    /* Note: This is a simple implementation that wipes custom colors. 
-       A better one would only reset the selected region. */
-    uint16_t i;
-    for (i = 0; i < FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT; i++) {
-        uint8_t current_attr = framebuffer[2 * i + 1];
-        /* If it looks like our highlight color (White on Blue), reset it */
-        if (current_attr == ((FRAMEBUFFER_COLOR_BLUE << 4) | (FRAMEBUFFER_COLOR_WHITE & 0x0F))) {
-             uint8_t attr = (FRAMEBUFFER_COLOR_BLACK << 4) | (FRAMEBUFFER_COLOR_LIGHT_GREY & 0x0F);
-             framebuffer[2 * i + 1] = attr;
+/* Copy the text of the line `back` lines above the cursor into `out`
+ * (NUL-terminated, trailing blanks trimmed). Returns the length.
+ */
+uint16_t fb_history_text(uint32_t back, char *out, uint16_t max) {
+    const uint16_t *line = line_above_cursor(back);
+    uint16_t n = 0;
+
+    if (max == 0)
+        return 0;
+    if (line != 0) {
+        uint16_t end = fb_w;
+        while (end > 0 && (uint8_t)line[end - 1] == ' ')
+            end--;
+        while (n < end && n < max - 1) {
+            out[n] = (char)(line[n] & 0xFF);
+            n++;
         }
     }
+    out[n] = '\0';
+    return n;
 }
 
-uint16_t get_cursor_x(void) { return cursor_x; }
-uint16_t get_cursor_y(void) { return cursor_y; }
+uint16_t get_cursor_x(void) { return con->cursor_x; }
+uint16_t get_cursor_y(void) { return con->cursor_y; }
 
 /* --- Tiny CLI parsing helpers (no libc) --- */
 
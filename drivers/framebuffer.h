@@ -1,5 +1,8 @@
 /* Simple VGA text-mode framebuffer driver interface
- * Assumes standard 80x25 text mode at physical address 0xB8000.
+ * Text mode at physical address 0xB8000; starts in the BIOS 80x25 mode,
+ * fb_set_mode() switches to 80x50 or 90x60 at runtime. Alternatively the
+ * same text console can be drawn on a linear framebuffer (fb_attach_lfb).
+ * Output goes to one of FB_NUM_CONSOLES virtual consoles.
  * Each cell is 2 bytes: ASCII character (low byte) and attribute (high byte).
  */
 
@@ -12,12 +15,25 @@ typedef unsigned char  uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int   uint32_t;
 typedef signed int     int32_t;
+typedef unsigned long long uint64_t;
 
-/* Framebuffer geometry and address for VGA text mode */
-#define FRAMEBUFFER_WIDTH   80
-#define FRAMEBUFFER_HEIGHT  25
+/* Largest supported geometry (per-console buffers are sized for it) and
+ * the address of VGA text memory. The current geometry is fb_width() x
+ * fb_height().
+ */
+#define FB_MAX_WIDTH        128
+#define FB_MAX_HEIGHT       60
+#define FB_MAX_CELLS        (FB_MAX_WIDTH * FB_MAX_HEIGHT)
 #define FRAMEBUFFER_ADDRESS 0x000B8000
 
+/* Number of virtual consoles (Alt+F1..F4), each with its own VGA page */
+#define FB_NUM_CONSOLES 4
+
+/* Lines kept in the scrollback ring (override with -DFB_SCROLLBACK_LINES=n) */
+#ifndef FB_SCROLLBACK_LINES
+#define FB_SCROLLBACK_LINES 1000
+#endif
+
 /* VGA colours (use when setting foreground/background attributes) */
 enum {
     FRAMEBUFFER_COLOR_BLACK = 0,
@@ -38,29 +54,166 @@ enum {
     FRAMEBUFFER_COLOR_WHITE = 15
 };
 
+/* Pack foreground/background colours into a VGA attribute byte */
+#define FB_ATTR(fg, bg) ((uint8_t)((((bg) & 0x0F) << 4) | ((fg) & 0x0F)))
+
+/* In-band colour escape for fb_write_buf/write_str: followed by one hex
+ * digit (foreground colour) or '*' (restore). See KCOLOR in kprintf.h.
+ */
+#define FB_COLOR_ESC '\x0F'
+
+/* ANSI escape sequences understood by put_char/write_str (per console):
+ *   ESC[r;cH, ESC[r;cf   cursor to row r, column c (1-based, default 1)
+ *   ESC[nA/B/C/D         cursor up/down/forward/back n (default 1)
+ *   ESC[nG               cursor to column n
+ *   ESC[nJ               erase screen: 0 cursor to end, 1 start to cursor, 2 all
+ *   ESC[nK               erase line: same values, within the cursor row
+ *   ESC[s, ESC[u         save/restore the cursor position
+ *   ESC 7, ESC 8         save/restore the cursor position and colours
+ *   ESC[a;b;...m         SGR: 0 reset, 1 bright, 22 normal, 30-37/90-97
+ *                        foreground, 40-47/100-107 background, 39/49 default
+ * Erasing uses the current colours and does not move the cursor.
+ * FB_ANSI_FG/BG give the SGR number for a FRAMEBUFFER_COLOR_* value, e.g.
+ *   k_printf(FB_CSI "%dm" "hi", FB_ANSI_FG(FRAMEBUFFER_COLOR_LIGHT_RED));
+ */
+#define FB_CSI        "\x1B["
+#define FB_ANSI_CLEAR FB_CSI "2J" FB_CSI "H"
+#define FB_ANSI_RGB(c) ((((c) & 1) << 2) | ((c) & 2) | (((c) >> 2) & 1))
+#define FB_ANSI_FG(c)  ((((c) & 8) ? 90 : 30) + FB_ANSI_RGB(c))
+#define FB_ANSI_BG(c)  ((((c) & 8) ? 100 : 40) + FB_ANSI_RGB(c))
+
+/* Output counters reported by fb_get_stats() */
+typedef struct {
+    uint32_t flushes;        /* fb_flush() calls that found dirty rows */
+    uint32_t cells_flushed;  /* cells actually copied to VGA memory */
+    uint32_t cursor_syncs;   /* hardware cursor register updates */
+    uint32_t hw_scrolls;     /* lines scrolled via the CRTC start address */
+    uint32_t ring_wraps;     /* full-screen copies when the VGA window wrapped */
+} fb_stats_t;
+
 /* Public API
  * - init_framebuffer(): clears the screen and sets default colours
  * - clear_screen(): fill the screen with spaces using the current colours
  * - set_color(fg,bg): set the current foreground/background colours
  * - move_cursor(x,y): move the hardware text cursor to (x,y)
- * - put_char(c): write a single character at the current cursor (handles \n)
+ * - put_char(c): write a single character at the current cursor (handles
+ *   \n, \r, \b and ANSI escape sequences)
  * - write_str(s): write a NUL-terminated string
+ * - fb_write_buf(s,len): write len bytes; honours \n, \r, \b, ANSI escapes
+ *   and FB_COLOR_ESC
  * - write_dec(value): write a signed decimal integer
+ * - fb_flush(): copy dirty rows of the shadow buffer to VGA memory
+ *   (write_str does this automatically; call it after bare put_char output)
+ * - fb_tick(): timer hook, flushes unless the driver is mid-update
  */
 void init_framebuffer(void);
+
+/* Text mode geometry
+ * - fb_set_mode(cols,rows): 80x25, 80x50 or 90x60; returns -1 if unsupported
+ * - fb_attach_lfb(cols,rows): draw on the linear framebuffer set up by
+ *   lfb_init() instead (call before init_framebuffer)
+ */
+int fb_set_mode(uint16_t cols, uint16_t rows);
+void fb_attach_lfb(uint16_t cols, uint16_t rows);
+uint16_t fb_width(void);
+uint16_t fb_height(void);
 void clear_screen(void);
 void set_color(uint8_t fg, uint8_t bg);
 void move_cursor(uint16_t x, uint16_t y);
 
 void put_char(char c);
 void write_str(const char *s);
+void fb_write_buf(const char *s, uint32_t len);
 void write_dec(int value);
 void write_dec_ll(long long value);
 
-/* Selection Support */
+/* Span API: bulk cell operations using 32-bit (two cells per word) stores.
+ * - fb_fill_cells(x,y,n,c,attr): fill n cells in screen order from (x,y)
+ * - fb_fill_rect(x,y,w,h,c,attr): fill a rectangle
+ * - fb_blit_cells(dx,dy,sx,sy,n): move n cells (overlap-safe)
+ * - fb_write_run(str,len,attr): write len chars at the cursor and advance it
+ * - fb_write_repeat(c,n,attr): write n copies of c at the cursor and advance it
+ * None of these interpret control characters.
+ */
+uint8_t fb_current_attr(void);
+void fb_fill_cells(uint16_t x, uint16_t y, uint16_t count, char c, uint8_t attr);
+void fb_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, char c, uint8_t attr);
+void fb_blit_cells(uint16_t dst_x, uint16_t dst_y, uint16_t src_x, uint16_t src_y, uint16_t count);
+void fb_write_run(const char *str, uint16_t len, uint8_t attr);
+void fb_write_repeat(char c, uint16_t count, uint8_t attr);
+
+void fb_flush(void);
+void fb_tick(void);
+void fb_get_stats(fb_stats_t *out);
+
+/* Selection Support (one selection per console, on the live screen)
+ * - framebuffer_highlight_region(x1,y1,x2,y2): select a range; (x1,y1) is the anchor
+ * - framebuffer_extend_selection(x,y): move the free end, touching only changed cells
+ * - framebuffer_clear_selection(): restore the original attributes
+ * - framebuffer_copy_selection(out,max): selected text, rows joined by '\n'
+ * Scrolling or clearing the console drops the selection.
+ */
 char framebuffer_get_char(uint16_t x, uint16_t y);
 void framebuffer_highlight_region(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+void framebuffer_extend_selection(uint16_t x, uint16_t y);
 void framebuffer_clear_selection(void);
+uint16_t framebuffer_copy_selection(char *out, uint16_t max);
+
+/* Mouse pointer (a cell of the displayed console with its colours flipped,
+ * drawn in VGA memory only)
+ * - fb_pointer_move(x,y): put it on cell (x,y); IRQ-safe, applied at the
+ *   next flush
+ * - fb_pointer_hide(): remove it
+ */
+void fb_pointer_move(uint16_t x, uint16_t y);
+void fb_pointer_hide(void);
+
+/* Status line (bottom screen row, shared by all consoles, never scrolls)
+ * - fb_status_enable(on): take the bottom row from the consoles (fb_height()
+ *   shrinks by one) or give it back; main context only
+ * - fb_status_set(text,attr): set the whole line (blank-padded); IRQ-safe,
+ *   only cells that changed are written at the next flush
+ */
+void fb_status_enable(int on);
+void fb_status_set(const char *text, uint8_t attr);
+
+/* Nonzero while a driver call is updating the shadow buffers (e.g. when
+ * a fault interrupts it); the screen must not be written then.
+ */
+int fb_driver_busy(void);
+
+/* Output mirror
+ * - fb_set_mirror(fn): also pass everything written at the cursor (put_char,
+ *   write_str, fb_write_buf, write_dec, fb_write_run, fb_write_repeat) to fn
+ *   (e.g. serial_console_write), with FB_COLOR_ESC, set_color, move_cursor
+ *   and clear_screen turned into ANSI sequences; 0 disables. Returns the
+ *   previous mirror. fn runs with the driver busy, possibly from the timer tick.
+ */
+typedef void (*fb_mirror_t)(const char *s, uint32_t len);
+fb_mirror_t fb_set_mirror(fb_mirror_t fn);
+
+/* Virtual consoles
+ * - fb_console_select(n): send output to console n (main context)
+ * - fb_console_show(n): display console n; IRQ-safe, applied at next flush
+ *   by reprogramming the CRTC start address (no copy)
+ */
+void fb_console_select(uint8_t n);
+uint8_t fb_console_current(void);
+void fb_console_show(uint8_t n);
+uint8_t fb_console_shown(void);
+
+/* Scrollback (per console)
+ * - fb_scrollback(n): view n lines further back on the displayed console
+ *   (negative = forward); IRQ-safe
+ * - fb_history_lines(): lines above the cursor row (scrollback + screen)
+ * - fb_history_find(needle, from, &found): newest-first search starting
+ *   `from` lines above the cursor row
+ * - fb_history_text(back, out, max): copy a line's text (trailing blanks trimmed)
+ */
+void fb_scrollback(int lines);
+uint32_t fb_history_lines(void);
+int fb_history_find(const char *needle, uint32_t from, uint32_t *found);
+uint16_t fb_history_text(uint32_t back, char *out, uint16_t max);
 
 /* Cursor getters */
 uint16_t get_cursor_x(void);
@@ -0,0 +1,54 @@
+#include "inputlat.h"
+
+/* Written from the main context only (the readers), so no locking */
+static inputlat_hist_t hist[INPUTLAT_STAGES];
+
+static const char *const stage_names[INPUTLAT_STAGES] = { "queue", "echo", "line" };
+
+/* Index of the highest set bit (0 for 0 and 1) */
+static inline uint32_t log2_floor(uint64_t v) {
+    uint32_t hi = (uint32_t)(v >> 32);
+    uint32_t r;
+
+    if (hi) {
+        __asm__("bsr %1, %0" : "=r"(r) : "rm"(hi));
+        return r + 32;
+    }
+    if ((uint32_t)v == 0)
+        return 0;
+    __asm__("bsr %1, %0" : "=r"(r) : "rm"((uint32_t)v));
+    return r;
+}
+
+void inputlat_add(uint8_t stage, uint64_t cycles) {
+    if (stage >= INPUTLAT_STAGES)
+        return;
+
+    inputlat_hist_t *h = &hist[stage];
+    uint32_t b = log2_floor(cycles);
+    if (b >= INPUTLAT_BUCKETS)
+        b = INPUTLAT_BUCKETS - 1;
+    h->buckets[b]++;
+    h->count++;
+    if (cycles > h->max)
+        h->max = cycles;
+}
+
+void inputlat_get(uint8_t stage, inputlat_hist_t *out) {
+    if (stage < INPUTLAT_STAGES)
+        *out = hist[stage];
+}
+
+void inputlat_reset(void) {
+    for (uint8_t s = 0; s < INPUTLAT_STAGES; s++) {
+        inputlat_hist_t *h = &hist[s];
+        for (uint32_t i = 0; i < INPUTLAT_BUCKETS; i++)
+            h->buckets[i] = 0;
+        h->count = 0;
+        h->max = 0;
+    }
+}
+
+const char *inputlat_stage_name(uint8_t stage) {
+    return stage < INPUTLAT_STAGES ? stage_names[stage] : "?";
+}
@@ -0,0 +1,28 @@
+#ifndef INCLUDE_INPUTLAT_H
+#define INCLUDE_INPUTLAT_H
+
+#include "types.h"
+
+// Input latency histograms. Every key event is stamped with the TSC when
+// it enters the keyboard queue (IRQ1, or a replayed key); readers report
+// when it reaches each stage below. Bucket i counts latencies in
+// [2^i, 2^(i+1)) cycles (bucket 0 also takes 0).
+#define INPUTLAT_QUEUE    0     // queued -> dequeued by a reader
+#define INPUTLAT_ECHO     1     // queued -> echo on screen
+#define INPUTLAT_LINE     2     // Enter queued -> line returned to the caller
+#define INPUTLAT_STAGES   3
+
+#define INPUTLAT_BUCKETS  40
+
+typedef struct {
+    uint32_t buckets[INPUTLAT_BUCKETS];
+    uint32_t count;
+    uint64_t max;
+} inputlat_hist_t;
+
+void inputlat_add(uint8_t stage, uint64_t cycles);
+void inputlat_get(uint8_t stage, inputlat_hist_t *out);
+void inputlat_reset(void);
+const char *inputlat_stage_name(uint8_t stage);
+
+#endif
@@ -1,13 +1,23 @@
 extern isr_handler
 extern irq_handler
+extern irq_exit
+extern irq_spurious
+extern irq_ack
+extern irq_entry
+extern trace_enabled
+
+KERNEL_DS equ 0x10      ; flat data segment of the boot loader's GDT
+IRQ_BASE  equ 32
+REGS_INT_NO equ 36      ; offset of int_no in registers_t
 
 isr_common_stub:
     pusha
+    cld                 ; C code (and rep movs/stos in the drivers) expects DF=0
 
     mov ax, ds
     push eax
 
-    mov ax, 0x10
+    mov ax, KERNEL_DS
     mov ds, ax
     mov es, ax
     mov fs, ax
@@ -27,13 +37,91 @@ isr_common_stub:
     add esp, 8
     iret
 
+; IRQ entry. The kernel runs in ring 0 with flat segments, so DS is almost
+; always KERNEL_DS already; the four segment loads (and the four on the
+; way out) are only done when it is not.
+; The line's acknowledge routine and its registered handler are called
+; straight from the per-line tables irq_ack and irq_entry, timed here, and
+; irq_exit does the accounting and deferred work. While tracing is on,
+; irq_handler does all of it in C instead, with its tracepoints.
 irq_common_stub:
     pusha
+    cld                 ; C code (and rep movs/stos in the drivers) expects DF=0
+
+    mov ax, ds
+    push eax
+    cmp ax, KERNEL_DS
+    jne .load_segments
+
+.dispatch:
+    push esp            ; registers_t *, the argument of every call below
+    cmp byte [trace_enabled], 0
+    jne .traced
+
+    mov ebx, [esp + 4 + REGS_INT_NO]   ; vector; ebx, esi, edi survive the calls
+    call [irq_ack + ebx*4 - IRQ_BASE*4]
+    test eax, eax
+    jnz .spurious
+
+    rdtsc
+    mov esi, eax
+    mov edi, edx
+    call [irq_entry + ebx*4 - IRQ_BASE*4]
+    rdtsc
+    sub eax, esi
+    sbb edx, edi
+    push edx            ; irq_exit(cycles, regs)
+    push eax
+    call irq_exit
+    add esp, 12
+    jmp .return
+
+.spurious:
+    call irq_spurious
+    add esp, 4
+    jmp .return
+
+.traced:
+    call irq_handler
+    add esp, 4
+
+.return:
+    pop eax
+    cmp ax, KERNEL_DS
+    jne .restore_segments
+
+    popa
+    add esp, 8
+    iret
+
+.load_segments:
+    mov ax, KERNEL_DS
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    jmp .dispatch
+
+.restore_segments:
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    popa
+    add esp, 8
+    iret
+
+%ifdef IRQ_BENCH_OLD
+; The IRQ entry as it was (segment reloads, everything in irq_handler),
+; for irq_bench() in kernels built with IRQBENCH_OLD=1.
+irq_full_stub:
+    pusha
+    cld
 
     mov ax, ds
     push eax
 
-    mov ax, 0x10
+    mov ax, KERNEL_DS
     mov ds, ax
     mov es, ax
     mov fs, ax
@@ -52,6 +140,7 @@ irq_common_stub:
     popa
     add esp, 8
     iret
+%endif
 
 %macro ISR_NOERRCODE 1
   global isr%1
@@ -126,5 +215,26 @@ IRQ   13,   45
 IRQ   14,   46
 IRQ   15,   47
 
+; Software-only vectors for irq_bench(): line 16 through the normal IRQ
+; entry, a bare iret, and (IRQBENCH_OLD=1) the same line through the old entry.
+IRQ   16,   48
+
+%ifdef IRQ_BENCH_OLD
+global irq_bench_full
+irq_bench_full:
+    push byte 0
+    push byte 48
+    jmp irq_full_stub
+%endif
+
+global irq_bench_bare
+irq_bench_bare:
+    iret
+
+; Local APIC spurious interrupt: no handler and no EOI
+global apic_spurious
+apic_spurious:
+    iret
+
 ; Mark stack as non-executable (silences ld warning about missing .note.GNU-stack)
 section .note.GNU-stack noalloc noexec nowrite progbits
@@ -0,0 +1,28 @@
+#ifndef INCLUDE_IRQFLAGS_H
+#define INCLUDE_IRQFLAGS_H
+
+#include "types.h"
+
+#define EFLAGS_IF 0x200
+
+// Disable interrupts and return the previous EFLAGS, for a short critical
+// section closed by irq_restore(). Nests correctly.
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ __volatile__("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    __asm__ __volatile__("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+// Non-zero when maskable interrupts are enabled (i.e. not in a handler
+// or critical section).
+static inline int irqs_enabled(void) {
+    uint32_t flags;
+    __asm__ __volatile__("pushfl; popl %0" : "=r"(flags));
+    return (flags & EFLAGS_IF) != 0;
+}
+
+#endif
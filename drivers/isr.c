@@ -1,43 +1,197 @@
 #include "isr.h"
 #include "idt.h"
-#include "framebuffer.h"
+#include "klog.h"
+#include "trace.h"
 #include "pic.h"
+#include "tsc.h"
+#include "irqflags.h"
+#include "kprintf.h"
+#include "softirq.h"
+#include "acpi.h"
+#include "apic.h"
+#include "serial.h"
+#include "framebuffer.h"
 
 // Lookup table for registered C interrupt handlers (indexed by vector 0-255).
 static isr_t interrupt_handlers[256];
 
+// Per-line IRQ counters (status line), plus the benchmark line.
+static volatile uint32_t irq_counts[IRQ_BENCH_LINE + 1];
+
+// Per-vector counts and handler cost. Only hard-interrupt context writes
+// them, through interrupt gates with IF=0 and before softirqs turn
+// interrupts back on, so the updates need no lock (readers and the reset
+// use irq_save()).
+static irq_vector_stat_t vector_stats[256];
+
+// OCW3: next read of the command port returns the in-service register
+#define PIC_READ_ISR 0x0B
+
+// Per-line acknowledge routines and handlers, indexed by line (0 to
+// IRQ_BENCH_LINE) in irq_common_stub, which calls both directly.
+typedef int (*irq_ack_t)(void);
+irq_ack_t irq_ack[IRQ_BENCH_LINE + 1];
+isr_t irq_entry[IRQ_BENCH_LINE + 1];
+
+// irq_entry of a line nobody registered a handler for
+static void no_handler(registers_t *regs) {
+    (void)regs;
+}
+
 void register_interrupt_handler(uint8_t n, isr_t handler) {
     interrupt_handlers[n] = handler;
+    if (n >= IRQ_BASE && n <= IRQ_BENCH)
+        irq_entry[n - IRQ_BASE] = handler ? handler : no_handler;
 }
 
-static void dispatch_interrupt(registers_t *regs) {
-    if (regs == 0) return;
-    uint32_t n = regs->int_no;
-    if (n >= 256) return;
+// Bucket for a handler cost of `cycles`: floor(log2), capped
+static inline uint32_t cost_bucket(uint32_t cycles) {
+    uint32_t b = 0;
+    if (cycles)
+        __asm__("bsr %1, %0" : "=r"(b) : "rm"(cycles));
+    return b < IRQSTAT_BUCKETS ? b : IRQSTAT_BUCKETS - 1;
+}
+
+// Add one run of a handler that took `dt` cycles
+static inline void account_handler(irq_vector_stat_t *st, uint64_t dt) {
+    uint32_t c = (dt >> 32) ? 0xFFFFFFFFu : (uint32_t)dt;
+    st->cycles += c;
+    if (c > st->max_cycles)
+        st->max_cycles = c;
+    st->hist[cost_bucket(c)]++;
+}
+
+// Run the handler for vector `n` (< 256), with accounting
+static inline void dispatch_interrupt(uint32_t n, registers_t *regs) {
+    irq_vector_stat_t *st = &vector_stats[n];
+    st->count++;
     isr_t handler = interrupt_handlers[n];
-    if (handler != 0) handler(regs);
+    if (handler != 0) {
+        TRACE_BEGIN(TRACE_DISPATCH, n);
+        uint64_t t0 = rdtsc();
+        handler(regs);
+        uint64_t dt = rdtsc() - t0;
+        TRACE_END(TRACE_DISPATCH, n);
+        account_handler(st, dt);
+    }
+}
+
+// Acknowledge routines for irq_ack, picked once in init_interrupt_gates()
+// so the IRQ path does no range checks: EOI the master, or the slave and
+// then the master. They return 1 for a spurious interrupt, which is not
+// dispatched.
+static int ack_master(void) {
+    outb(PIC_1_COMMAND, PIC_ACKNOWLEDGE);
+    return 0;
+}
+
+static int ack_slave(void) {
+    outb(PIC_2_COMMAND, PIC_ACKNOWLEDGE);
+    outb(PIC_1_COMMAND, PIC_ACKNOWLEDGE);
+    return 0;
+}
+
+// IRQ7 and IRQ15 are also what a PIC raises when a request goes away
+// before it is acknowledged. Then the line's in-service bit is clear and
+// the PIC that raised it must not get an EOI (the master still needs one
+// for the cascade when the slave raised it).
+static int ack_irq7(void) {
+    outb(PIC_1_COMMAND, PIC_READ_ISR);
+    if (!(inb(PIC_1_COMMAND) & 0x80))
+        return 1;
+    return ack_master();
+}
+
+static int ack_irq15(void) {
+    outb(PIC_2_COMMAND, PIC_READ_ISR);
+    if (!(inb(PIC_2_COMMAND) & 0x80)) {
+        ack_master();
+        return 1;
+    }
+    return ack_slave();
+}
+
+// I/O APIC mode: one store to the local APIC for every line
+static int ack_lapic(void) {
+    apic_eoi();
+    return 0;
+}
+
+// The benchmark line is raised with `int`: nothing to acknowledge
+static int ack_none(void) {
+    return 0;
+}
+
+// An exception nobody handles: returning would re-run the faulting
+// instruction forever. Print the record now, while nothing else can run,
+// and stop. The console is skipped if the fault hit the framebuffer
+// driver in the middle of an update.
+static void __attribute__((noreturn)) fatal_exception(registers_t *regs) {
+    klog(KLOG_ERR, "Unhandled exception %u (error %x) at %x:%x, eflags %x",
+         regs->int_no, regs->err_code, regs->cs, regs->eip, regs->eflags);
+    if (fb_driver_busy())
+        klog_set_sink(KLOG_SINK_CONSOLE, 0, KLOG_ERR);
+    klog_drain();
+    serial_flush();
+
+    for (;;)
+        __asm__ __volatile__("cli; hlt");
 }
 
 // CPU exceptions (vectors 0-31).
 void isr_handler(registers_t *regs) {
     if (regs == 0 || regs->int_no >= 256 || interrupt_handlers[regs->int_no] == 0) {
-        write_str("Unhandled Interrupt: ");
-        if (regs != 0) write_dec(regs->int_no);
-        put_char('\n');
+        if (regs && regs->int_no < 32)
+            fatal_exception(regs);
+        klog(KLOG_ERR, "Unhandled Interrupt: %u", regs ? regs->int_no : 0);
         return;
     }
-    dispatch_interrupt(regs);
+    dispatch_interrupt(regs->int_no, regs);
+}
+
+// Deferred work runs on the way out of an IRQ, with interrupts enabled
+// again, if the interrupted code had them enabled.
+static inline void irq_return(registers_t *regs) {
+    if ((regs->eflags & EFLAGS_IF) && softirq_pending())
+        softirq_run();
+}
+
+// Shared tail of irq_common_stub, after the line's handler ran for
+// `cycles`.
+void irq_exit(uint64_t cycles, registers_t *regs) {
+    uint32_t n = regs->int_no;
+    irq_vector_stat_t *st = &vector_stats[n];
+
+    irq_counts[n - IRQ_BASE]++;
+    st->count++;
+    if (interrupt_handlers[n] != 0)
+        account_handler(st, cycles);
+    irq_return(regs);
 }
 
-// Hardware IRQs (vectors 32-47 after PIC remap).
+// irq_common_stub, when the line's acknowledge routine found no request
+void irq_spurious(registers_t *regs) {
+    vector_stats[regs->int_no].spurious++;
+}
+
+// Hardware IRQs (vectors 32-47 after PIC remap) while tracing is on, and
+// the old entry of irq_bench(); irq_common_stub does the same work without
+// the tracepoints. Only reached from the irq stubs, which push vectors
+// IRQ0..IRQ_BENCH.
 void irq_handler(registers_t *regs) {
-    if (regs == 0 || regs->int_no >= 256) return;
+    uint32_t n = regs->int_no;
+    uint32_t irq = n - IRQ_BASE;
 
-    // EOI (End Of Interrupt): if from slave, ACK slave then master; otherwise just master.
-    if (regs->int_no >= PIC_2_OFFSET) outb(PIC_2_COMMAND, PIC_ACKNOWLEDGE);
-    outb(PIC_1_COMMAND, PIC_ACKNOWLEDGE);
+    if (irq_ack[irq]()) {
+        irq_spurious(regs);
+        return;
+    }
+    TRACE_BEGIN(TRACE_IRQ, irq);
+    irq_counts[irq]++;
+    dispatch_interrupt(n, regs);
+    TRACE_END(TRACE_IRQ, irq);
 
-    dispatch_interrupt(regs);
+    irq_return(regs);
 }
 
 typedef void (*stub_t)(void);
@@ -56,6 +210,26 @@ extern void irq0(void);  extern void irq1(void);  extern void irq2(void);  exter
 extern void irq4(void);  extern void irq5(void);  extern void irq6(void);  extern void irq7(void);
 extern void irq8(void);  extern void irq9(void);  extern void irq10(void); extern void irq11(void);
 extern void irq12(void); extern void irq13(void); extern void irq14(void); extern void irq15(void);
+extern void irq16(void); extern void irq_bench_bare(void);
+extern void apic_spurious(void);
+#ifdef IRQ_BENCH_OLD
+extern void irq_bench_full(void);
+#endif
+
+static const stub_t irq_stubs[16] = {
+    irq0,  irq1,  irq2,  irq3,  irq4,  irq5,  irq6,  irq7,
+    irq8,  irq9,  irq10, irq11, irq12, irq13, irq14, irq15
+};
+
+#define KERNEL_CS 0x08
+#define INT_GATE  0x8E
+
+#define IRQ_BENCH_FULL (IRQ_BENCH + 1)
+#define IRQ_BENCH_BARE (IRQ_BENCH + 2)
+
+static void bench_callback(registers_t *regs) {
+    (void)regs;
+}
 
 void init_interrupt_gates(void) {
     // Install CPU exception handlers.
@@ -66,9 +240,6 @@ void init_interrupt_gates(void) {
         isr24, isr25, isr26, isr27, isr28, isr29, isr30, isr31
     };
 
-    const uint16_t KERNEL_CS = 0x08;
-    const uint8_t  INT_GATE  = 0x8E;
-
     for (uint8_t i = 0; i < 32; i++) {
         idt_set_gate(i, (uint32_t)isr_stubs[i], KERNEL_CS, INT_GATE);
     }
@@ -77,12 +248,139 @@ void init_interrupt_gates(void) {
     pic_remap(PIC_1_OFFSET, PIC_2_OFFSET);
 
     // Install hardware IRQ handlers.
-    static const stub_t irq_stubs[16] = {
-        irq0,  irq1,  irq2,  irq3,  irq4,  irq5,  irq6,  irq7,
-        irq8,  irq9,  irq10, irq11, irq12, irq13, irq14, irq15
-    };
-
     for (uint8_t i = 0; i < 16; i++) {
         idt_set_gate(IRQ(i), (uint32_t)irq_stubs[i], KERNEL_CS, INT_GATE);
+        irq_ack[i] = (i < 8) ? ack_master : ack_slave;
+    }
+    for (uint8_t i = 0; i <= IRQ_BENCH_LINE; i++)
+        if (irq_entry[i] == 0)
+            irq_entry[i] = no_handler;
+    irq_ack[7] = ack_irq7;
+    irq_ack[15] = ack_irq15;
+
+    // Benchmark vectors, raised only by irq_bench()
+    idt_set_gate(IRQ_BENCH, (uint32_t)irq16, KERNEL_CS, INT_GATE);
+#ifdef IRQ_BENCH_OLD
+    idt_set_gate(IRQ_BENCH_FULL, (uint32_t)irq_bench_full, KERNEL_CS, INT_GATE);
+#endif
+    idt_set_gate(IRQ_BENCH_BARE, (uint32_t)irq_bench_bare, KERNEL_CS, INT_GATE);
+    irq_ack[IRQ_BENCH_LINE] = ack_none;
+    register_interrupt_handler(IRQ_BENCH, bench_callback);
+}
+
+// Interrupt controller in use: the 8259 pair, or the I/O APIC once
+// init_apic_routing() succeeded
+static uint8_t apic_mode = 0;
+static acpi_madt_t madt;
+
+// APIC vectors: the local APIC delivers the pending interrupt with the
+// highest vector first, by classes of 16, so the upper nibble ranks the
+// lines - timer, then keyboard and mouse, then COM1, then the rest - and
+// the lower one is the line. The stubs still report the line as IRQ(n).
+static const uint8_t apic_class[16] = {
+    0xE, 0xD, 0x5, 0x5, 0xC, 0x5, 0x5, 0x5,
+    0x5, 0x5, 0x5, 0x5, 0xD, 0x5, 0x5, 0x5
+};
+
+#define APIC_VECTOR(line) ((uint8_t)(apic_class[line] << 4 | (line)))
+
+int init_apic_routing(void) {
+    if (acpi_parse_madt(&madt) < 0 || apic_init(&madt) < 0)
+        return -1;
+
+    // The 8259s stay remapped to 0x20-0x2F but fully masked, and the local
+    // APIC ignores their output (LINT0 masked)
+    outb(PIC_1_DATA, 0xFF);
+    outb(PIC_2_DATA, 0xFF);
+
+    for (uint8_t i = 0; i < 16; i++) {
+        if (apic_route_irq(i, APIC_VECTOR(i)) < 0)
+            continue;
+        idt_set_gate(APIC_VECTOR(i), (uint32_t)irq_stubs[i], KERNEL_CS, INT_GATE);
+        irq_ack[i] = ack_lapic;
+    }
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)apic_spurious, KERNEL_CS, INT_GATE);
+    apic_mode = 1;
+
+    klog(KLOG_INFO, "irq: I/O APIC at 0x%x, local APIC %u at 0x%x, %u CPU(s), timer on input %u",
+         madt.ioapic[0].addr, apic_id(), madt.lapic_addr, madt.cpu_count, apic_gsi(0));
+    return 0;
+}
+
+int irq_apic_active(void) {
+    return apic_mode;
+}
+
+void irq_unmask(uint8_t irq) {
+    if (irq >= 16)
+        return;
+    uint32_t flags = irq_save();
+    if (apic_mode) {
+        apic_unmask_irq(irq);
+    } else if (irq < 8) {
+        outb(PIC_1_DATA, inb(PIC_1_DATA) & ~(1 << irq));
+    } else {
+        outb(PIC_2_DATA, inb(PIC_2_DATA) & ~(1 << (irq - 8)));
+        outb(PIC_1_DATA, inb(PIC_1_DATA) & ~(1 << 2));     // cascade
+    }
+    irq_restore(flags);
+}
+
+uint32_t irq_get_count(uint8_t irq) {
+    return (irq < 16) ? irq_counts[irq] : 0;
+}
+
+// Copy one vector's accounting with interrupts off, so it is consistent
+void irq_get_vector_stat(uint8_t vector, irq_vector_stat_t *out) {
+    uint32_t flags = irq_save();
+    *out = vector_stats[vector];
+    irq_restore(flags);
+}
+
+// Cycles per `int vector` round trip over `rounds` (the vector has to be
+// an immediate, hence one function per vector)
+#define INT_LOOP(name, vector)                                          \
+    static uint32_t name(uint32_t rounds) {                             \
+        uint64_t t0 = rdtsc();                                          \
+        for (uint32_t i = 0; i < rounds; i++)                           \
+            __asm__ __volatile__("int %0" :: "i"(vector) : "memory");   \
+        uint64_t dt = rdtsc() - t0;                                     \
+        k_divmod_u64(&dt, rounds);                                      \
+        return (uint32_t)dt;                                            \
+    }
+
+INT_LOOP(int_bare, IRQ_BENCH_BARE)
+INT_LOOP(int_lean, IRQ_BENCH)
+#ifdef IRQ_BENCH_OLD
+INT_LOOP(int_full, IRQ_BENCH_FULL)
+#endif
+
+void irq_bench(uint32_t rounds, irq_bench_t *out) {
+    if (rounds == 0)
+        rounds = 1;
+    // Interrupts off so the timer does not land in the loops (`int`
+    // ignores IF, and iret restores it off)
+    uint32_t flags = irq_save();
+    out->bare = int_bare(rounds);
+#ifdef IRQ_BENCH_OLD
+    out->full = int_full(rounds);
+#else
+    out->full = 0;
+#endif
+    out->lean = int_lean(rounds);
+    irq_restore(flags);
+}
+
+void irq_reset_stats(void) {
+    uint32_t flags = irq_save();
+    for (uint32_t n = 0; n < 256; n++) {
+        irq_vector_stat_t *st = &vector_stats[n];
+        st->count = 0;
+        st->spurious = 0;
+        st->max_cycles = 0;
+        st->cycles = 0;
+        for (uint32_t i = 0; i < IRQSTAT_BUCKETS; i++)
+            st->hist[i] = 0;
     }
+    irq_restore(flags);
 }
@@ -24,6 +24,10 @@
 #define IRQ14 IRQ(14)
 #define IRQ15 IRQ(15)
 
+// Software-only line for irq_bench(); never raised by the PIC.
+#define IRQ_BENCH_LINE 16
+#define IRQ_BENCH      IRQ(IRQ_BENCH_LINE)
+
 // CPU register snapshot pushed by the ASM stubs.
 typedef struct registers {
     uint32_t ds;                  // Data segment selector
@@ -37,4 +41,48 @@ typedef void (*isr_t)(registers_t *regs);
 void register_interrupt_handler(uint8_t n, isr_t handler);
 void init_interrupt_gates(void);
 
+// Route IRQs through the I/O APIC and local APIC described by the ACPI
+// MADT instead of the 8259s (which are masked). Call after
+// init_interrupt_gates() and before any driver unmasks its line; returns
+// -1, leaving the 8259s in charge, if there is no usable APIC.
+int init_apic_routing(void);
+int irq_apic_active(void);
+
+// Let ISA line `irq` (0-15) interrupt, on whichever controller is in use
+void irq_unmask(uint8_t irq);
+
+// Number of times PIC line `irq` (0-15) has fired since boot.
+uint32_t irq_get_count(uint8_t irq);
+
+// Per-vector accounting (always on): how often each vector was dispatched
+// and the TSC cycles spent in its handler - total, worst case and a log2
+// histogram (bucket i counts [2^i, 2^(i+1)) cycles, the last bucket
+// everything above). Spurious IRQ7/IRQ15 (no request in the PIC's
+// in-service register) are counted and not dispatched.
+#define IRQSTAT_BUCKETS 24
+
+typedef struct {
+    uint32_t count;
+    uint32_t spurious;
+    uint32_t max_cycles;
+    uint64_t cycles;
+    uint32_t hist[IRQSTAT_BUCKETS];
+} irq_vector_stat_t;
+
+void irq_get_vector_stat(uint8_t vector, irq_vector_stat_t *out);
+void irq_reset_stats(void);
+
+// Average cycles per `int` round trip, measured with interrupts off,
+// to an empty handler: a bare iret, the current IRQ entry, and the one it
+// replaced (segment reloads, all dispatch in irq_handler). The old entry
+// is only built with IRQBENCH_OLD=1 (-DIRQ_BENCH_OLD); otherwise `full`
+// is 0.
+typedef struct {
+    uint32_t bare;
+    uint32_t full;
+    uint32_t lean;
+} irq_bench_t;
+
+void irq_bench(uint32_t rounds, irq_bench_t *out);
+
 #endif
@@ -2,8 +2,17 @@
 #include "isr.h"
 #include "io.h"
 #include "framebuffer.h"
+#include "serial.h"
+#include "mouse.h"
+#include "replay.h"
+#include "klog.h"
+#include "trace.h"
+#include "timer.h"
+#include "tsc.h"
+#include "inputlat.h"
+#include "softirq.h"
 
-/* US Keyboard Layout scancode table. */
+/* US Keyboard Layout scancode table (unshifted). */
 unsigned char kbdus[128] =
 {
     0,  27, '1', '2', '3', '4', '5', '6', '7', '8',	/* 9 */
@@ -41,91 +50,584 @@ unsigned char kbdus[128] =
     0,	/* All other keys are undefined */
 };
 
-/* Circular Buffer for Keyboard Input */
-#define KB_BUFFER_SIZE 256
-static char kb_buffer[KB_BUFFER_SIZE];
-static volatile uint32_t kb_write_ptr = 0;
-static volatile uint32_t kb_read_ptr = 0;
+/* The same keys with Shift held */
+static const unsigned char kbdus_shift[128] =
+{
+    0,  27, '!', '@', '#', '$', '%', '^', '&', '*',	/* 9 */
+  '(', ')', '_', '+', '\b',	/* Backspace */
+  '\t',			/* Tab */
+  'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', '\n',	/* Enter key */
+    0,			/* 29   - Control */
+  'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~',   0,		/* Left shift */
+  '|', 'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?',   0,				/* Right shift */
+  '*',
+    0,	/* Alt */
+  ' ',	/* Space bar */
+};
+
+/* Keypad 7..'.' with Num Lock on; with it off they are the navigation keys */
+static const char keypad_chars[KEY_KP_DOT - KEY_KP7 + 1] = {
+    '7', '8', '9', '-', '4', '5', '6', '+', '1', '2', '3', '0', '.'
+};
+
+/* Decoder state, owned by the keyboard softirq */
+#define SC_EXTENDED  0xE0
+#define SC_PAUSE     0xE1
+#define SC_RELEASE   0x80
+
+static uint8_t ext_prefix = 0;      /* last byte was 0xE0 */
+static uint8_t pause_skip = 0;      /* bytes of the Pause sequence still to come */
+static uint8_t held = 0;            /* HELD_* bits */
+static uint8_t locks = KBD_MOD_NUM; /* KBD_MOD_CAPS / KBD_MOD_NUM */
+
+#define HELD_LSHIFT  0x01
+#define HELD_RSHIFT  0x02
+#define HELD_LCTRL   0x04
+#define HELD_RCTRL   0x08
+#define HELD_LALT    0x10
+#define HELD_RALT    0x20
+
+static inline uint8_t current_mods(void) {
+    uint8_t m = locks;
+    if (held & (HELD_LSHIFT | HELD_RSHIFT)) m |= KBD_MOD_SHIFT;
+    if (held & (HELD_LCTRL | HELD_RCTRL))   m |= KBD_MOD_CTRL;
+    if (held & (HELD_LALT | HELD_RALT))     m |= KBD_MOD_ALT;
+    return m;
+}
+
+/* Input queue of key events: (released << 15) | (mods << 8) | keycode.
+ * Single producer (softirq context: the keyboard decoder, or replay from
+ * the timer softirq; softirqs never interleave), single consumer (the
+ * reader). Indices run free
+ * and are masked, so head - tail is the fill level even across wrap;
+ * each side writes only its own index, after the data it publishes or
+ * consumes (x86 keeps stores in order, so a compiler barrier suffices).
+ */
+#define KB_QUEUE_SIZE 1024      /* power of two */
+#define KB_QUEUE_MASK (KB_QUEUE_SIZE - 1)
+static uint16_t kb_queue[KB_QUEUE_SIZE];
+static uint64_t kb_stamp[KB_QUEUE_SIZE];    /* TSC when each event arrived */
+static volatile uint32_t kb_head = 0;       /* written by softirqs only */
+static volatile uint32_t kb_tail = 0;       /* written by the reader only */
+static volatile uint32_t kb_dropped = 0;
+static uint8_t kb_overflowing = 0;
+
+/* Raw scancodes and the TSC when IRQ1 read them, waiting for the
+ * keyboard softirq. Single producer (IRQ1), single consumer (the softirq).
+ */
+#define SC_RING_SIZE 64         /* power of two */
+static uint8_t sc_ring[SC_RING_SIZE];
+static uint64_t sc_stamp[SC_RING_SIZE];
+static volatile uint32_t sc_head = 0;
+static volatile uint32_t sc_tail = 0;
+static volatile uint32_t sc_dropped = 0;
+
+#define BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/* Append an event that arrived at TSC `stamp` (softirq context). A full
+ * queue drops it and counts it; the first drop of a burst is also logged.
+ */
+static void queue_push(uint16_t e, uint64_t stamp) {
+    uint32_t head = kb_head;
+
+    if (head - kb_tail >= KB_QUEUE_SIZE) {
+        if (!kb_overflowing)
+            klog(KLOG_WARN, "kbd: input queue full, dropping keys");
+        kb_overflowing = 1;
+        kb_dropped++;
+        return;
+    }
+    kb_overflowing = 0;
+    kb_queue[head & KB_QUEUE_MASK] = e;
+    kb_stamp[head & KB_QUEUE_MASK] = stamp;
+    BARRIER();
+    kb_head = head + 1;
+}
+
+/* Take the oldest event, if any, and the TSC stamp it was queued with */
+static int queue_pop(kbd_event_t *ev, uint64_t *stamp) {
+    uint32_t tail = kb_tail;
+    if (tail == kb_head)
+        return 0;
+
+    BARRIER();
+    uint16_t e = kb_queue[tail & KB_QUEUE_MASK];
+    *stamp = kb_stamp[tail & KB_QUEUE_MASK];
+    BARRIER();
+    kb_tail = tail + 1;
+
+    ev->keycode = (uint8_t)e;
+    ev->mods = (uint8_t)((e >> 8) & 0x7F);
+    ev->released = (uint8_t)(e >> 15);
+    return 1;
+}
+
+uint32_t kbd_dropped(void) {
+    return kb_dropped + sc_dropped;
+}
+
+/* Public API: queue a press of the key that kbd_translate() turns into
+ * `k` (a character or KBD_KEY() code), as if it had been typed. Softirq
+ * context only: softirqs never interleave, so the keyboard decoder and
+ * the caller keep the queue to one producer at a time. Returns 0, -1 if
+ * the queue is full, -2 if no key gives `k`.
+ */
+int kbd_inject(int k) {
+    uint8_t key = 0;
+    uint8_t mods = 0;
+
+    if (k >= 0x100) {
+        key = (uint8_t)k;
+    } else if (k >= 1 && k <= 26 && k != '\t' && k != '\b' && k != '\n') {
+        /* Ctrl+letter */
+        mods = KBD_MOD_CTRL;
+        k += 'a' - 1;
+    }
+
+    if (key == 0) {
+        for (uint8_t i = 1; i < 128 && key == 0; i++)
+            if (kbdus[i] == k)
+                key = i;
+        for (uint8_t i = 1; i < 128 && key == 0; i++)
+            if (kbdus_shift[i] == k) {
+                key = i;
+                mods |= KBD_MOD_SHIFT;
+            }
+        if (key == 0)
+            return -2;
+    }
+
+    if (kb_head - kb_tail >= KB_QUEUE_SIZE)
+        return -1;
+    queue_push((uint16_t)(mods << 8 | key), rdtsc());
+    return 0;
+}
+
+int kbd_translate(const kbd_event_t *ev) {
+    uint8_t k = ev->keycode;
+
+    if (ev->released)
+        return -1;
+
+    switch (k) {
+    case KEY_LSHIFT: case KEY_RSHIFT: case KEY_LCTRL: case KEY_RCTRL:
+    case KEY_LALT: case KEY_RALT: case KEY_CAPSLOCK: case KEY_NUMLOCK:
+    case KEY_SCROLLLOCK:
+        return -1;
+    case KEY_KP_ENTER:
+        return '\n';
+    case KEY_KP_SLASH:
+        return '/';
+    }
+
+    if (k >= KEY_KP7 && k <= KEY_KP_DOT) {
+        char c = keypad_chars[k - KEY_KP7];
+        /* '-' and '+' are never navigation keys */
+        if ((ev->mods & KBD_MOD_NUM) || c == '-' || c == '+')
+            return c;
+        return KBD_KEY(KEY_EXT | k);
+    }
+
+    if (k & KEY_EXT)
+        return KBD_KEY(k);
+
+    int shift = (ev->mods & KBD_MOD_SHIFT) != 0;
+    char c = (char)(shift ? kbdus_shift[k] : kbdus[k]);
+    if (c == 0)
+        return KBD_KEY(k);
+
+    /* Caps Lock flips the case of letters only */
+    if ((ev->mods & KBD_MOD_CAPS) && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+        c ^= 0x20;
+
+    if ((ev->mods & KBD_MOD_CTRL) && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+        return c & 0x1F;
+
+    return (uint8_t)c;
+}
+
+/* Non-zero if the last byte from the serial line was '\r' */
+static uint8_t serial_cr = 0;
+
+/* Terminal escape sequences for the editing keys: ESC [ <final> or
+ * ESC [ <n> ~ (also ESC O <final>, sent in application cursor mode).
+ */
+static uint8_t serial_esc = 0;      /* 0, 1 after ESC, 2 inside the sequence */
+static uint8_t serial_esc_param = 0;
+
+static int serial_escape(int c) {
+    if (serial_esc == 1) {
+        serial_esc = (c == '[' || c == 'O') ? 2 : 0;
+        serial_esc_param = 0;
+        return -1;
+    }
+    if (c >= '0' && c <= '9') {
+        serial_esc_param = (uint8_t)(serial_esc_param * 10 + (c - '0'));
+        return -1;
+    }
+
+    serial_esc = 0;
+    switch (c) {
+    case 'A': return KBD_KEY(KEY_UP);
+    case 'B': return KBD_KEY(KEY_DOWN);
+    case 'C': return KBD_KEY(KEY_RIGHT);
+    case 'D': return KBD_KEY(KEY_LEFT);
+    case 'H': return KBD_KEY(KEY_HOME);
+    case 'F': return KBD_KEY(KEY_END);
+    case '~':
+        switch (serial_esc_param) {
+        case 1: case 7: return KBD_KEY(KEY_HOME);
+        case 2: return KBD_KEY(KEY_INSERT);
+        case 3: return KBD_KEY(KEY_DELETE);
+        case 4: case 8: return KBD_KEY(KEY_END);
+        case 5: return KBD_KEY(KEY_PAGE_UP);
+        case 6: return KBD_KEY(KEY_PAGE_DOWN);
+        }
+        break;
+    }
+    return -1;
+}
+
+/* Next character or key typed on the serial console, or -1. Terminals send
+ * '\r' (or "\r\n") for Enter and DEL for Backspace; map them to what the
+ * keyboard produces.
+ */
+static int serial_input(void) {
+    int c;
+    while ((c = serial_getc()) >= 0) {
+        if (serial_esc) {
+            c = serial_escape(c);
+            if (c >= 0)
+                return c;
+            continue;
+        }
+        if (c == 0x1B) {
+            serial_esc = 1;
+            continue;
+        }
+        if (c == '\n' && serial_cr) {
+            serial_cr = 0;
+            continue;
+        }
+        serial_cr = (c == '\r');
+        if (c == '\r')
+            c = '\n';
+        else if (c == 0x7F)
+            c = '\b';
+        return c;
+    }
+    return -1;
+}
 
-/* Write a character to the circular buffer */
-static void buffer_write(char c) {
-    uint32_t next_write = (kb_write_ptr + 1) % KB_BUFFER_SIZE;
-    if (next_write != kb_read_ptr) { // Buffer not full
-        kb_buffer[kb_write_ptr] = c;
-        kb_write_ptr = next_write;
+/* Latency bookkeeping (main context): queue stamps of the keys read since
+ * the reader last reported its echo, and of the last Enter read.
+ */
+#define ECHO_PENDING_MAX 64
+static uint64_t echo_pending[ECHO_PENDING_MAX];
+static uint32_t echo_count = 0;
+static uint64_t enter_stamp = 0;
+
+/* Public API: next character or KBD_KEY() code from the keyboard queue or
+ * the serial line, or -1 if neither has one. Translation happens here,
+ * not in the IRQ.
+ */
+int kbd_try_getkey(void) {
+    kbd_event_t ev;
+    uint64_t stamp;
+
+    while (queue_pop(&ev, &stamp)) {
+        int k = kbd_translate(&ev);
+        if (k >= 0) {
+            /* Typing brings the console that receives the echo back into view */
+            fb_console_show(fb_console_current());
+            replay_note_key(k);
+
+            inputlat_add(INPUTLAT_QUEUE, rdtsc() - stamp);
+            if (echo_count < ECHO_PENDING_MAX)
+                echo_pending[echo_count++] = stamp;
+            if (k == '\n')
+                enter_stamp = stamp;
+            return k;
+        }
     }
-    // Else drop character (buffer full)
+
+    int k = serial_input();
+    if (k >= 0)
+        replay_note_key(k);
+    if (k == '\n')
+        enter_stamp = 0;    /* not timed: serial bytes carry no stamp */
+    return k;
+}
+
+/* Public API: the keys read so far are echoed and on screen */
+void kbd_echo_done(void) {
+    if (echo_count == 0)
+        return;
+
+    uint64_t now = rdtsc();
+    for (uint32_t i = 0; i < echo_count; i++)
+        inputlat_add(INPUTLAT_ECHO, now - echo_pending[i]);
+    echo_count = 0;
 }
 
-/* Read a character from the circular buffer (blocking call) */
-static char buffer_read(void) {
-    // Wait until buffer has data (read and write pointers differ)
-    while (kb_read_ptr == kb_write_ptr) {
-        // Halt CPU until next interrupt (keyboard IRQ will wake us up)
+/* Public API: the keys read so far are not echoed (not timed) */
+void kbd_echo_skip(void) {
+    echo_count = 0;
+    enter_stamp = 0;
+}
+
+/* Public API: the line ended by the last Enter read is being returned */
+void kbd_line_done(void) {
+    if (enter_stamp == 0)
+        return;
+    inputlat_add(INPUTLAT_LINE, rdtsc() - enter_stamp);
+    enter_stamp = 0;
+}
+
+/* Public API: like kbd_try_getkey, skipping keys without a character */
+int kbd_try_getc(void) {
+    int k;
+    while ((k = kbd_try_getkey()) >= 0x100)
+        ;
+    return k;
+}
+
+/* Public API: copy the characters already waiting, up to n and stopping
+ * after a newline, without blocking. Returns how many were copied.
+ */
+uint32_t kbd_read(char *buf, uint32_t n) {
+    uint32_t got = 0;
+
+    while (got < n) {
+        int c = kbd_try_getc();
+        if (c < 0)
+            break;
+        buf[got++] = (char)c;
+        if (c == '\n')
+            break;
+    }
+    return got;
+}
+
+static inline int input_pending(void) {
+    return kb_head != kb_tail || serial_rx_pending();
+}
+
+/* Public API: sleep until input arrives or timeout_ms passes (0 waits
+ * forever). Returns 1 if input is waiting, 0 on timeout.
+ */
+int kbd_wait(uint32_t timeout_ms) {
+    uint32_t hz = timer_get_hz();
+    uint32_t start = timer_get_ticks();
+    uint32_t ticks = timeout_ms / 1000 * hz + ((timeout_ms % 1000) * hz + 999) / 1000;
+
+    for (;;) {
+        if (input_pending())
+            return 1;
+        if (timeout_ms && timer_get_ticks() - start >= ticks)
+            return 0;
+
+        // About to block: run deferred interrupt work, apply mouse drags,
+        // print pending log records and make sure the prompt and any echo
+        // are on screen
+        softirq_run();
+        if (input_pending())
+            continue;
+        mouse_poll();
+        klog_drain();
+        fb_flush();
+
+        // Halt CPU until next interrupt (keyboard, mouse, serial or timer). The
+        // check and the halt run with interrupts off, and `sti; hlt` only
+        // opens them on the halt, so an IRQ in between cannot be missed.
         // In a real OS with multitasking, we would yield to another process here
-        __asm__ __volatile__("hlt");
+        __asm__ __volatile__("cli");
+        if (input_pending() || softirq_pending())
+            __asm__ __volatile__("sti");
+        else
+            __asm__ __volatile__("sti; hlt");
+        TRACE_INSTANT(TRACE_KBD_WAKE, input_pending());
     }
-    
-    // Read character and advance read pointer
-    char c = kb_buffer[kb_read_ptr];
-    kb_read_ptr = (kb_read_ptr + 1) % KB_BUFFER_SIZE;
-    return c;
+}
+
+/* Public API: next character or KBD_KEY() code (blocking) */
+int kbd_getkey(void) {
+    int k;
+    while ((k = kbd_try_getkey()) < 0)
+        kbd_wait(0);
+    return k;
 }
 
 /* Public API: Get a single character */
 char kbd_getc(void) {
-    return buffer_read();
+    int k;
+    while ((k = kbd_try_getc()) < 0)
+        kbd_wait(0);
+    return (char)k;
 }
 
-/* Public API: Read a line of input until Enter is pressed or max_len is reached */
+/* Public API: Read a line of input until Enter is pressed or max_len is
+ * reached. Input is taken in batches (kbd_read never reads past a newline,
+ * so the rest of a pasted text stays queued for the next call) and each
+ * batch is echoed with one write.
+ */
 void kbd_readline(char* buffer, uint32_t max_len) {
+    static char batch[64];
+    static char echo[64];
     uint32_t i = 0;
+
     while (i < max_len - 1) {
-        char c = kbd_getc();  // Blocking call, waits for keyboard input
-        
-        if (c == '\n') {
-            // Enter key pressed, terminate string and return
-            buffer[i] = '\0';
-            return;
-        } else if (c == '\b') {
-            // Backspace: remove last character from buffer if any
-            if (i > 0) {
-                i--;
+        uint32_t room = max_len - 1 - i;
+        uint32_t n = kbd_read(batch, room < sizeof(batch) ? room : sizeof(batch));
+        if (n == 0) {
+            kbd_wait(0);  // Blocking call, waits for keyboard or serial input
+            continue;
+        }
+
+        uint32_t e = 0;
+        for (uint32_t k = 0; k < n; k++) {
+            char c = batch[k];
+            if (c == '\n') {
+                // Enter key pressed, terminate string and return
+                echo[e++] = '\n';
+                fb_write_buf(echo, e);
+                kbd_echo_done();
+                buffer[i] = '\0';
+                kbd_line_done();
+                return;
+            } else if (c == '\b') {
+                // Backspace: remove last character from buffer if any
+                if (i > 0) {
+                    i--;
+                    echo[e++] = '\b';
+                }
+            } else if ((c >= ' ' && c < 0x7F) || c == '\t') {
+                // Regular character: add to buffer and echo it
+                buffer[i++] = c;
+                echo[e++] = c;
             }
-        } else {
-            // Regular character: add to buffer
-            buffer[i++] = c;
         }
+        if (e)
+            fb_write_buf(echo, e);
+        kbd_echo_done();
     }
     // Max length reached, null terminate the string
     buffer[i] = '\0';
 }
 
-/* Keyboard interrupt handler (IRQ1) called when a key is pressed or released */
+/* Decode one scancode byte, read by IRQ1 at TSC `stamp`, into a key event
+ * and queue it. Only the Alt+F1..F4 and Shift+PgUp/PgDn bindings act
+ * here, since they must work while the shell is busy; everything else
+ * (translation, echo) is left to the reader.
+ */
+static void decode_scancode(uint8_t scancode, uint64_t stamp) {
+    if (pause_skip) {
+        if (--pause_skip == 0)
+            queue_push((uint16_t)(current_mods() << 8 | KEY_PAUSE), stamp);
+        return;
+    }
+    if (scancode == SC_PAUSE) {
+        pause_skip = 5;
+        return;
+    }
+    if (scancode == SC_EXTENDED) {
+        ext_prefix = 1;
+        return;
+    }
+
+    uint8_t released = scancode & SC_RELEASE;
+    uint8_t key = scancode & ~SC_RELEASE;
+    if (ext_prefix)
+        key |= KEY_EXT;
+    ext_prefix = 0;
+
+    uint8_t bit = 0;
+    switch (key) {
+    case (KEY_EXT | KEY_LSHIFT):
+    case (KEY_EXT | KEY_RSHIFT):
+        return;     /* fake shifts around Print Screen and the E0 keys */
+    case KEY_LSHIFT: bit = HELD_LSHIFT; break;
+    case KEY_RSHIFT: bit = HELD_RSHIFT; break;
+    case KEY_LCTRL:  bit = HELD_LCTRL;  break;
+    case KEY_RCTRL:  bit = HELD_RCTRL;  break;
+    case KEY_LALT:   bit = HELD_LALT;   break;
+    case KEY_RALT:   bit = HELD_RALT;   break;
+    case KEY_CAPSLOCK:
+        if (!released) locks ^= KBD_MOD_CAPS;
+        break;
+    case KEY_NUMLOCK:
+        if (!released) locks ^= KBD_MOD_NUM;
+        break;
+    }
+    if (bit) {
+        if (released) held &= ~bit;
+        else          held |= bit;
+    }
+
+    uint8_t mods = current_mods();
+
+    if (!released) {
+        /* Alt+F1..F4 flips the display to another virtual console */
+        if ((mods & KBD_MOD_ALT) && key >= KEY_F1 && key < KEY_F1 + 4) {
+            fb_console_show((uint8_t)(key - KEY_F1));
+            return;
+        }
+        /* Shift+PgUp / Shift+PgDn page through the scrollback */
+        if ((mods & KBD_MOD_SHIFT) && (key == KEY_PAGE_UP || key == (KEY_PAGE_UP & ~KEY_EXT))) {
+            fb_scrollback(fb_height() / 2);
+            return;
+        }
+        if ((mods & KBD_MOD_SHIFT) && (key == KEY_PAGE_DOWN || key == (KEY_PAGE_DOWN & ~KEY_EXT))) {
+            fb_scrollback(-(fb_height() / 2));
+            return;
+        }
+    }
+
+    queue_push((uint16_t)((released ? 0x8000 : 0) | mods << 8 | key), stamp);
+}
+
+/* Keyboard softirq: decode everything IRQ1 has read since the last run */
+static void keyboard_softirq(void) {
+    uint32_t tail = sc_tail;
+
+    while (tail != sc_head) {
+        BARRIER();
+        uint8_t scancode = sc_ring[tail & (SC_RING_SIZE - 1)];
+        uint64_t stamp = sc_stamp[tail & (SC_RING_SIZE - 1)];
+        BARRIER();
+        sc_tail = ++tail;
+        decode_scancode(scancode, stamp);
+    }
+}
+
+/* Keyboard interrupt handler (IRQ1): read the scancode, stamp it and leave
+ * the decoding to the softirq.
+ */
 static void keyboard_callback(registers_t *regs) {
     (void)regs;  // Unused parameter
 
     /* Read scancode from keyboard controller data port (0x60) */
     /* We skip the status check (inb(0x64) & 1) because the IRQ implies data is ready */
     uint8_t scancode = inb(0x60);
+    uint32_t head = sc_head;
 
-    if (scancode & 0x80) {
-        /* Bit 7 set = key release event - ignore for now */
+    if (head - sc_tail >= SC_RING_SIZE) {
+        sc_dropped++;
     } else {
-        /* Bit 7 clear = key press event */
-        char c = kbdus[scancode];
-        if (c != 0) {
-            put_char(c);      /* Echo character to screen immediately */
-            buffer_write(c);  /* Store character in circular buffer for kbd_getc() */
-        }
+        sc_ring[head & (SC_RING_SIZE - 1)] = scancode;
+        sc_stamp[head & (SC_RING_SIZE - 1)] = rdtsc();
+        BARRIER();
+        sc_head = head + 1;
     }
-    
+    softirq_raise(SOFTIRQ_KEYBOARD);
+
     /* PIC EOI (End of Interrupt) is handled by irq_handler wrapper in isr.c */
 }
 
 /* Initialize keyboard driver: register IRQ handler and enable keyboard interrupts */
 void init_keyboard(void) {
    // Register our callback function to handle IRQ1 (keyboard interrupt)
+   register_softirq(SOFTIRQ_KEYBOARD, "keyboard", keyboard_softirq);
    register_interrupt_handler(IRQ1, keyboard_callback);
    
    /* Flush keyboard controller buffer to prevent initial stuck key behavior */
@@ -142,11 +644,6 @@ void init_keyboard(void) {
    /* Command 0xAE = Enable keyboard (0xAD would disable it) */
    outb(0x64, 0xAE);
 
-   /* Explicitly unmask IRQ1 (Keyboard) on the PIC Master data port (0x21) */
-   /* Get current interrupt mask */
-   uint8_t mask = inb(0x21);
-   /* Clear bit 1 (IRQ1) to enable keyboard interrupts */
-   mask &= ~(1 << 1);
-   /* Write back the updated mask */
-   outb(0x21, mask);
+   /* Unmask IRQ1 (Keyboard) on the PIC or I/O APIC */
+   irq_unmask(1);
 }
@@ -3,8 +3,99 @@
 
 #include "types.h"
 
+// Keycodes: the scancode-set-1 make code, with KEY_EXT set for keys sent
+// with an 0xE0 prefix (so every key fits in one byte).
+#define KEY_EXT         0x80
+
+#define KEY_ESC         0x01
+#define KEY_BACKSPACE   0x0E
+#define KEY_TAB         0x0F
+#define KEY_ENTER       0x1C
+#define KEY_LCTRL       0x1D
+#define KEY_LSHIFT      0x2A
+#define KEY_RSHIFT      0x36
+#define KEY_LALT        0x38
+#define KEY_CAPSLOCK    0x3A
+#define KEY_F1          0x3B    // F1..F10 are consecutive
+#define KEY_F10         0x44
+#define KEY_NUMLOCK     0x45
+#define KEY_SCROLLLOCK  0x46
+#define KEY_KP7         0x47    // keypad 7..'.' (0x47-0x53); navigation
+#define KEY_KP_DOT      0x53    // keys while Num Lock is off
+#define KEY_F11         0x57
+#define KEY_F12         0x58
+
+#define KEY_KP_ENTER    (KEY_EXT | 0x1C)
+#define KEY_RCTRL       (KEY_EXT | 0x1D)
+#define KEY_KP_SLASH    (KEY_EXT | 0x35)
+#define KEY_RALT        (KEY_EXT | 0x38)
+#define KEY_PAUSE       (KEY_EXT | 0x45)    // sent as E1 1D 45 E1 9D C5
+#define KEY_HOME        (KEY_EXT | 0x47)
+#define KEY_UP          (KEY_EXT | 0x48)
+#define KEY_PAGE_UP     (KEY_EXT | 0x49)
+#define KEY_LEFT        (KEY_EXT | 0x4B)
+#define KEY_RIGHT       (KEY_EXT | 0x4D)
+#define KEY_END         (KEY_EXT | 0x4F)
+#define KEY_DOWN        (KEY_EXT | 0x50)
+#define KEY_PAGE_DOWN   (KEY_EXT | 0x51)
+#define KEY_INSERT      (KEY_EXT | 0x52)
+#define KEY_DELETE      (KEY_EXT | 0x53)
+
+// Modifier state at the time of a key event
+#define KBD_MOD_SHIFT   0x01
+#define KBD_MOD_CTRL    0x02
+#define KBD_MOD_ALT     0x04
+#define KBD_MOD_CAPS    0x08    // Caps Lock on
+#define KBD_MOD_NUM     0x10    // Num Lock on
+
+// One key press or release, as queued by the keyboard softirq
+typedef struct {
+    uint8_t keycode;
+    uint8_t mods;
+    uint8_t released;
+} kbd_event_t;
+
+// kbd_getkey() result for keys that produce no character
+#define KBD_KEY(keycode)  (0x100 | (keycode))
+
 void init_keyboard(void);
+
+// Character for a key press: ASCII (Ctrl+letter gives the control code),
+// KBD_KEY(keycode) for other keys, or -1 for modifiers and releases.
+int kbd_translate(const kbd_event_t *ev);
+
+// Reads, keyboard and serial line merged (no echo):
+// - kbd_getkey(): next character or KBD_KEY() code (blocking)
+// - kbd_getc(): next character, skipping other keys (blocking)
+// - kbd_try_getkey()/kbd_try_getc(): the same, or -1 if nothing is waiting
+// - kbd_read(buf,n): copy up to n waiting characters, stopping after '\n';
+//   never blocks, returns the count
+// - kbd_wait(ms): sleep until input is waiting (1) or ms pass (0);
+//   0 ms waits forever
+int kbd_getkey(void);
 char kbd_getc(void);
+int kbd_try_getkey(void);
+int kbd_try_getc(void);
+uint32_t kbd_read(char *buf, uint32_t n);
+int kbd_wait(uint32_t timeout_ms);
+
+// Key events lost to a full input queue
+uint32_t kbd_dropped(void);
+
+// Queue a press of the key that reads back as `k` (character or KBD_KEY()
+// code), as if typed. Softirq context only. 0, -1 if the queue is full, -2 if
+// no key produces `k`.
+int kbd_inject(int k);
+
+// Input latency (see inputlat.h): a reader calls kbd_echo_done() once the
+// echo of the keys it has read is on screen, and kbd_line_done() when it
+// returns the line ended by the last Enter read. kbd_echo_skip() drops the
+// keys read so far from the timing (readers that do not echo).
+void kbd_echo_done(void);
+void kbd_echo_skip(void);
+void kbd_line_done(void);
+
+// Read a line with echo and Backspace editing until Enter or max_len - 1
 void kbd_readline(char* buffer, uint32_t max_len);
 
 #endif
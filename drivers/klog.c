@@ -0,0 +1,129 @@
+#include "klog.h"
+#include "kprintf.h"
+#include "irqflags.h"
+#include "timer.h"
+
+static klog_record_t ring[KLOG_RECORDS];
+static uint32_t head = 0;   /* sequence number of the next record */
+
+typedef struct {
+    klog_write_t fn;
+    uint8_t max_level;
+    uint32_t next;          /* first sequence number not yet written */
+} klog_sink_t;
+
+static klog_sink_t sinks[KLOG_SINKS];
+
+static const char *const level_names[] = { "err", "warn", "info", "debug" };
+
+const char *klog_level_name(uint8_t level) {
+    return (level <= KLOG_DEBUG) ? level_names[level] : "?";
+}
+
+/* Format outside the critical section; only claiming the slot and copying
+ * the record into it run with interrupts off.
+ */
+void klog(uint8_t level, const char *fmt, ...) {
+    char text[KLOG_MSG_MAX];
+    __builtin_va_list ap;
+
+    __builtin_va_start(ap, fmt);
+    int n = k_vsnprintf(text, sizeof(text), fmt, ap);
+    __builtin_va_end(ap);
+
+    if (n > KLOG_MSG_MAX - 1)
+        n = KLOG_MSG_MAX - 1;
+    while (n > 0 && text[n - 1] == '\n')
+        n--;
+
+    uint32_t flags = irq_save();
+    klog_record_t *r = &ring[head % KLOG_RECORDS];
+    r->seq = head++;
+    r->ticks = timer_get_ticks();
+    r->level = level;
+    r->len = (uint8_t)n;
+    for (int i = 0; i < n; i++)
+        r->text[i] = text[i];
+    r->text[n] = '\0';
+    irq_restore(flags);
+}
+
+uint32_t klog_first_seq(void) {
+    uint32_t h = head;
+    return (h > KLOG_RECORDS) ? h - KLOG_RECORDS : 0;
+}
+
+uint32_t klog_next_seq(void) {
+    return head;
+}
+
+/* Copy with interrupts off so a concurrent klog() cannot reuse the slot
+ * halfway through.
+ */
+int klog_read(uint32_t seq, klog_record_t *out) {
+    int ret = -1;
+    uint32_t flags = irq_save();
+
+    if (seq < head && seq >= klog_first_seq()) {
+        *out = ring[seq % KLOG_RECORDS];
+        ret = 0;
+    }
+    irq_restore(flags);
+    return ret;
+}
+
+int klog_format(const klog_record_t *r, char *buf, uint32_t size) {
+    uint32_t hz = timer_get_hz();
+    if (hz == 0)
+        hz = TIMER_DEFAULT_HZ;
+
+    int n = k_snprintf(buf, size, "[%5u.%03u] %s: %s\n",
+                       r->ticks / hz, (r->ticks % hz) * 1000u / hz,
+                       klog_level_name(r->level), r->text);
+    return (n < (int)size) ? n : (int)size - 1;
+}
+
+void klog_set_sink(uint8_t sink, klog_write_t fn, uint8_t max_level) {
+    if (sink >= KLOG_SINKS)
+        return;
+    sinks[sink].max_level = max_level;
+    sinks[sink].next = klog_first_seq();
+    sinks[sink].fn = fn;
+}
+
+void klog_set_level(uint8_t sink, uint8_t max_level) {
+    if (sink < KLOG_SINKS)
+        sinks[sink].max_level = max_level;
+}
+
+uint8_t klog_get_level(uint8_t sink) {
+    return (sink < KLOG_SINKS) ? sinks[sink].max_level : 0;
+}
+
+/* Hand every record a sink has not seen yet to it */
+void klog_drain(void) {
+    static klog_record_t r;
+    static char line[KLOG_MSG_MAX + 32];
+
+    for (uint8_t i = 0; i < KLOG_SINKS; i++) {
+        klog_sink_t *s = &sinks[i];
+        if (s->fn == 0)
+            continue;
+
+        while (s->next != head) {
+            if (klog_read(s->next, &r) != 0) {
+                uint32_t first = klog_first_seq();
+                int n = k_snprintf(line, sizeof(line), "klog: %u messages lost\n",
+                                   first - s->next);
+                s->fn(line, (uint32_t)n);
+                s->next = first;
+                continue;
+            }
+            s->next++;
+            if (r.level > s->max_level)
+                continue;
+            int n = klog_format(&r, line, sizeof(line));
+            s->fn(line, (uint32_t)n);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef INCLUDE_KLOG_H
+#define INCLUDE_KLOG_H
+
+#include "types.h"
+
+// Kernel log. klog() formats one line into a fixed in-memory ring of
+// records (sequence number, timer tick, level) and returns; nothing is
+// printed until klog_drain() hands new records to the sinks. Safe in IRQ
+// context, where it costs a format and a record copy.
+#define KLOG_ERR    0
+#define KLOG_WARN   1
+#define KLOG_INFO   2
+#define KLOG_DEBUG  3
+
+#define KLOG_RECORDS  128   // ring size in records (power of two)
+#define KLOG_MSG_MAX  118   // text bytes per record, NUL included
+
+typedef struct {
+    uint32_t seq;
+    uint32_t ticks;
+    uint8_t  level;
+    uint8_t  len;
+    char     text[KLOG_MSG_MAX];
+} klog_record_t;
+
+void klog(uint8_t level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Sinks: each gets every record at or above its level (numerically <=),
+// in order, at the next klog_drain() (main context only). Records that
+// were overwritten before a sink saw them are reported as lost.
+#define KLOG_SINK_CONSOLE  0
+#define KLOG_SINK_SERIAL   1
+#define KLOG_SINKS         2
+
+typedef void (*klog_write_t)(const char *s, uint32_t len);
+
+void klog_set_sink(uint8_t sink, klog_write_t fn, uint8_t max_level);
+void klog_set_level(uint8_t sink, uint8_t max_level);
+uint8_t klog_get_level(uint8_t sink);
+void klog_drain(void);
+
+// Replay (dmesg)
+// - klog_first_seq()/klog_next_seq(): the sequence numbers still in the ring
+// - klog_read(seq,out): copy a record; -1 if it has been overwritten
+// - klog_format(r,buf,size): "[    s.mmm] level: text\n", returns length
+uint32_t klog_first_seq(void);
+uint32_t klog_next_seq(void);
+int klog_read(uint32_t seq, klog_record_t *out);
+int klog_format(const klog_record_t *r, char *buf, uint32_t size);
+const char *klog_level_name(uint8_t level);
+
+#endif
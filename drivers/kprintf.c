@@ -0,0 +1,247 @@
+#include "kprintf.h"
+#include "framebuffer.h"
+
+/* "00" "01" ... "99": two decimal digits per lookup, so converting a number
+ * takes one step per pair of digits instead of one per digit.
+ */
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* v / 100 for any 32-bit v, as a multiply by the scaled reciprocal
+ * ceil(2^37 / 100) and a shift (no divide instruction).
+ */
+static inline uint32_t div100(uint32_t v) {
+    return (uint32_t)(((uint64_t)v * 0x51EB851Fu) >> 37);
+}
+
+char *k_fmt_u32(char *end, uint32_t value) {
+    char *p = end;
+
+    while (value >= 100) {
+        uint32_t q = div100(value);
+        uint32_t r = value - q * 100;
+        p -= 2;
+        p[0] = digit_pairs[2 * r];
+        p[1] = digit_pairs[2 * r + 1];
+        value = q;
+    }
+
+    if (value >= 10) {
+        p -= 2;
+        p[0] = digit_pairs[2 * value];
+        p[1] = digit_pairs[2 * value + 1];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return p;
+}
+
+/* Divide a 64-bit value in place by a 32-bit divisor and return the
+ * remainder. Two 32-bit `div` instructions instead of a libgcc call; the
+ * second never overflows because its high half is already < d.
+ */
+static inline uint32_t divmod_u64(uint64_t *n, uint32_t d) {
+    uint32_t hi = (uint32_t)(*n >> 32);
+    uint32_t lo = (uint32_t)*n;
+    uint32_t qhi = hi / d;
+    uint32_t r = hi - qhi * d;
+    uint32_t qlo;
+
+    __asm__("divl %4" : "=a"(qlo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+
+    *n = ((uint64_t)qhi << 32) | qlo;
+    return r;
+}
+
+uint32_t k_divmod_u64(uint64_t *n, uint32_t d) {
+    return divmod_u64(n, d);
+}
+
+char *k_fmt_u64(char *end, uint64_t value) {
+    char *p = end;
+
+    /* Peel off 8 digits per hardware divide until the rest fits in 32 bits. */
+    while (value >> 32) {
+        uint32_t chunk = divmod_u64(&value, 100000000u);
+        char *q = k_fmt_u32(p, chunk);
+        while (q > p - 8)
+            *--q = '0';
+        p -= 8;
+    }
+    return k_fmt_u32(p, (uint32_t)value);
+}
+
+static char *fmt_hex(char *end, uint64_t value, int upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char *p = end;
+    do {
+        *--p = digits[value & 0xF];
+        value >>= 4;
+    } while (value);
+    return p;
+}
+
+/* Output cursor for k_vsnprintf: counts every character, stores those that fit. */
+typedef struct {
+    char *buf;
+    uint32_t size;
+    uint32_t len;
+} out_t;
+
+static inline void out_char(out_t *o, char c) {
+    if (o->len + 1 < o->size)
+        o->buf[o->len] = c;
+    o->len++;
+}
+
+static void out_padded(out_t *o, const char *s, uint32_t n, char sign,
+                       int width, int left, char pad) {
+    int total = (int)n + (sign ? 1 : 0);
+    int fill = (width > total) ? width - total : 0;
+
+    if (!left && pad == ' ')
+        while (fill-- > 0) out_char(o, ' ');
+    if (sign)
+        out_char(o, sign);
+    if (!left && pad == '0')
+        while (fill-- > 0) out_char(o, '0');
+    for (uint32_t i = 0; i < n; i++)
+        out_char(o, s[i]);
+    if (left)
+        while (fill-- > 0) out_char(o, ' ');
+}
+
+int k_vsnprintf(char *buf, uint32_t size, const char *fmt, __builtin_va_list ap) {
+    out_t o = { buf, size, 0 };
+    char num[24];
+    char *end = num + sizeof(num);
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            out_char(&o, *fmt++);
+            continue;
+        }
+        fmt++;
+
+        int left = 0;
+        char pad = ' ';
+        for (;; fmt++) {
+            if (*fmt == '-') left = 1;
+            else if (*fmt == '0') pad = '0';
+            else break;
+        }
+        if (left) pad = ' ';
+
+        int width = 0;
+        while (*fmt >= '0' && *fmt <= '9')
+            width = width * 10 + (*fmt++ - '0');
+
+        int lng = 0;
+        while (*fmt == 'l') {
+            lng++;
+            fmt++;
+        }
+
+        char conv = *fmt;
+        if (conv == '\0')
+            break;
+        fmt++;
+
+        char *p;
+        char sign = 0;
+
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            int64_t v = (lng >= 2) ? __builtin_va_arg(ap, long long) : __builtin_va_arg(ap, int);
+            uint64_t u;
+            if (v < 0) {
+                sign = '-';
+                /* Magnitude without overflowing on the most negative value */
+                u = (uint64_t)(-(v + 1)) + 1u;
+            } else {
+                u = (uint64_t)v;
+            }
+            p = (u >> 32) ? k_fmt_u64(end, u) : k_fmt_u32(end, (uint32_t)u);
+            out_padded(&o, p, (uint32_t)(end - p), sign, width, left, pad);
+            break;
+        }
+        case 'u': {
+            uint64_t u = (lng >= 2) ? __builtin_va_arg(ap, unsigned long long) : __builtin_va_arg(ap, unsigned int);
+            p = (u >> 32) ? k_fmt_u64(end, u) : k_fmt_u32(end, (uint32_t)u);
+            out_padded(&o, p, (uint32_t)(end - p), 0, width, left, pad);
+            break;
+        }
+        case 'x':
+        case 'X': {
+            uint64_t u = (lng >= 2) ? __builtin_va_arg(ap, unsigned long long) : __builtin_va_arg(ap, unsigned int);
+            p = fmt_hex(end, u, conv == 'X');
+            out_padded(&o, p, (uint32_t)(end - p), 0, width, left, pad);
+            break;
+        }
+        case 'p': {
+            uint32_t u = (uint32_t)__builtin_va_arg(ap, void *);
+            p = fmt_hex(end, u, 0);
+            while (p > end - 8)
+                *--p = '0';
+            out_padded(&o, p, 8, 0, width, left, ' ');
+            break;
+        }
+        case 'c': {
+            char c = (char)__builtin_va_arg(ap, int);
+            out_padded(&o, &c, 1, 0, width, left, ' ');
+            break;
+        }
+        case 's': {
+            const char *s = __builtin_va_arg(ap, const char *);
+            if (s == 0) s = "(null)";
+            uint32_t n = 0;
+            while (s[n]) n++;
+            out_padded(&o, s, n, 0, width, left, ' ');
+            break;
+        }
+        case '%':
+            out_char(&o, '%');
+            break;
+        default:
+            /* Unknown conversion: print it verbatim */
+            out_char(&o, '%');
+            out_char(&o, conv);
+            break;
+        }
+    }
+
+    if (size > 0)
+        buf[(o.len < size) ? o.len : size - 1] = '\0';
+    return (int)o.len;
+}
+
+int k_snprintf(char *buf, uint32_t size, const char *fmt, ...) {
+    __builtin_va_list ap;
+    __builtin_va_start(ap, fmt);
+    int n = k_vsnprintf(buf, size, fmt, ap);
+    __builtin_va_end(ap);
+    return n;
+}
+
+int k_printf(const char *fmt, ...) {
+    char buf[K_PRINTF_BUF];
+    __builtin_va_list ap;
+
+    __builtin_va_start(ap, fmt);
+    int n = k_vsnprintf(buf, sizeof(buf), fmt, ap);
+    __builtin_va_end(ap);
+
+    uint32_t len = (n < (int)sizeof(buf)) ? (uint32_t)n : sizeof(buf) - 1;
+    fb_write_buf(buf, len);
+    return n;
+}
@@ -0,0 +1,44 @@
+#ifndef INCLUDE_KPRINTF_H
+#define INCLUDE_KPRINTF_H
+
+#include "types.h"
+
+/* Freestanding printf family.
+ * Conversions: %d %i %u %x %X %c %s %p %% with optional flags '-' and '0',
+ * a field width, and length modifiers l (same as int here) / ll (64-bit).
+ *
+ * Colour escape: KCOLOR expands to the console escape byte followed by a
+ * %c conversion; pass KC(colour) as its argument to switch the foreground
+ * colour (FRAMEBUFFER_COLOR_*) mid-string. KCOLOR_RESET restores the
+ * colour the write started with. Example:
+ *   k_printf("sum = " KCOLOR "%d" KCOLOR_RESET "\n", KC(primary), s);
+ */
+#define KCOLOR        "\x0F%c"
+#define KCOLOR_RESET  "\x0F" "*"
+#define KC(color)     ("0123456789abcdef"[(color) & 0x0F])
+
+/* Format into `buf` (always NUL-terminated when size > 0). Returns the
+ * length the full output would have had, like C99 snprintf.
+ */
+int k_vsnprintf(char *buf, uint32_t size, const char *fmt, __builtin_va_list ap);
+int k_snprintf(char *buf, uint32_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Format into a stack buffer and write it to the console as one span
+ * (output longer than K_PRINTF_BUF - 1 characters is truncated).
+ */
+#define K_PRINTF_BUF 256
+int k_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* Digits of an unsigned value, written backwards ending at `end`.
+ * Returns a pointer to the first digit. Needs up to 10 / 20 bytes.
+ */
+char *k_fmt_u32(char *end, uint32_t value);
+char *k_fmt_u64(char *end, uint64_t value);
+
+/* Divide *n by d in place and return the remainder (64-bit division
+ * without libgcc).
+ */
+uint32_t k_divmod_u64(uint64_t *n, uint32_t d);
+
+#endif
@@ -0,0 +1,207 @@
+#include "lfb.h"
+#include "font8x8.h"
+
+/* Text console on a linear framebuffer.
+ * The framebuffer driver keeps producing VGA-style text cells; this module
+ * turns them into pixels. Three things keep that cheap:
+ * - a glyph cache of pre-expanded cells: for a (character, attribute) pair
+ *   all 8x16 pixels are computed once, after which drawing a cell is 16
+ *   row copies of 32 bytes;
+ * - `shown`, a copy of the cell drawn at every position, so only cells
+ *   that actually changed are redrawn;
+ * - scrolling moves the existing pixel rows up with one wide memmove and
+ *   only the new rows are drawn.
+ */
+
+#define LFB_MAX_CELLS  (128 * 60)
+#define GLYPH_PIXELS   (LFB_CELL_WIDTH * LFB_CELL_HEIGHT)
+#define CACHE_ENTRIES  512
+#define NO_CELL        0xFFFFFFFFu
+
+static volatile uint8_t *lfb = 0;
+static uint32_t lfb_pitch;
+static uint16_t cols, rows;
+
+/* VGA palette as packed framebuffer pixels */
+static uint32_t palette[16];
+
+/* Cell drawn at each screen position (NO_CELL = unknown, must redraw) */
+static uint32_t shown[LFB_MAX_CELLS];
+static uint16_t shown_cursor = 0xFFFF;
+
+/* Direct-mapped glyph cache keyed by the 16-bit cell value */
+static uint32_t cache_tag[CACHE_ENTRIES];
+static uint32_t cache_pixels[CACHE_ENTRIES][GLYPH_PIXELS];
+
+static const uint8_t vga_rgb[16][3] = {
+    {   0,   0,   0 }, {   0,   0, 170 }, {   0, 170,   0 }, {   0, 170, 170 },
+    { 170,   0,   0 }, { 170,   0, 170 }, { 170,  85,   0 }, { 170, 170, 170 },
+    {  85,  85,  85 }, {  85,  85, 255 }, {  85, 255,  85 }, {  85, 255, 255 },
+    { 255,  85,  85 }, { 255,  85, 255 }, { 255, 255,  85 }, { 255, 255, 255 },
+};
+
+static uint32_t pack_channel(uint8_t value, uint8_t pos, uint8_t size) {
+    if (size == 0)
+        return 0;
+    if (size > 8)
+        size = 8;
+    return ((uint32_t)value >> (8 - size)) << pos;
+}
+
+int lfb_init(const multiboot_info_t *mbi) {
+    if (mbi == 0 || !(mbi->flags & MULTIBOOT_INFO_FRAMEBUFFER))
+        return -1;
+    if (mbi->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || mbi->framebuffer_bpp != 32)
+        return -1;
+    if ((mbi->framebuffer_addr >> 32) != 0)
+        return -1;
+
+    uint32_t c = mbi->framebuffer_width / LFB_CELL_WIDTH;
+    uint32_t r = mbi->framebuffer_height / LFB_CELL_HEIGHT;
+    if (c == 0 || r == 0)
+        return -1;
+    if (c > 128) c = 128;
+    if (r > 60) r = 60;
+
+    lfb = (volatile uint8_t *)(uint32_t)mbi->framebuffer_addr;
+    lfb_pitch = mbi->framebuffer_pitch;
+    cols = (uint16_t)c;
+    rows = (uint16_t)r;
+
+    for (int i = 0; i < 16; i++) {
+        palette[i] = pack_channel(vga_rgb[i][0], mbi->red_field_position, mbi->red_mask_size) |
+                     pack_channel(vga_rgb[i][1], mbi->green_field_position, mbi->green_mask_size) |
+                     pack_channel(vga_rgb[i][2], mbi->blue_field_position, mbi->blue_mask_size);
+    }
+
+    for (uint32_t i = 0; i < CACHE_ENTRIES; i++)
+        cache_tag[i] = NO_CELL;
+    for (uint32_t i = 0; i < LFB_MAX_CELLS; i++)
+        shown[i] = NO_CELL;
+    shown_cursor = 0xFFFF;
+    return 0;
+}
+
+uint16_t lfb_cols(void) { return cols; }
+uint16_t lfb_rows(void) { return rows; }
+
+/* Pixels of `cell`, expanding it into the cache on a miss. */
+static const uint32_t *glyph_pixels(uint16_t cell) {
+    uint32_t slot = ((uint32_t)cell * 0x9E3779B1u) >> 23;   /* 9-bit hash */
+    uint32_t *px = cache_pixels[slot];
+
+    if (cache_tag[slot] == cell)
+        return px;
+
+    uint8_t ch = (uint8_t)cell;
+    uint32_t fg = palette[(cell >> 8) & 0x0F];
+    uint32_t bg = palette[(cell >> 12) & 0x0F];
+    const uint8_t *bits = 0;
+    if (ch >= FONT8X8_FIRST && ch < FONT8X8_FIRST + FONT8X8_GLYPHS)
+        bits = font8x8_ascii[ch - FONT8X8_FIRST];
+
+    for (uint32_t y = 0; y < LFB_CELL_HEIGHT; y++) {
+        uint8_t line = bits ? bits[y / 2] : 0;
+        for (uint32_t x = 0; x < LFB_CELL_WIDTH; x++)
+            *px++ = (line & (1u << x)) ? fg : bg;
+    }
+
+    cache_tag[slot] = cell;
+    return cache_pixels[slot];
+}
+
+static inline volatile uint32_t *cell_origin(uint16_t index) {
+    uint32_t x = (uint32_t)(index % cols) * LFB_CELL_WIDTH;
+    uint32_t y = (uint32_t)(index / cols) * LFB_CELL_HEIGHT;
+    return (volatile uint32_t *)(lfb + y * lfb_pitch + x * 4);
+}
+
+static void draw_cell(uint16_t index, uint16_t cell) {
+    const uint32_t *src = glyph_pixels(cell);
+    volatile uint32_t *dst = cell_origin(index);
+
+    for (uint32_t y = 0; y < LFB_CELL_HEIGHT; y++) {
+        for (uint32_t x = 0; x < LFB_CELL_WIDTH; x++)
+            dst[x] = src[x];
+        src += LFB_CELL_WIDTH;
+        dst = (volatile uint32_t *)((volatile uint8_t *)dst + lfb_pitch);
+    }
+}
+
+/* Underline cursor: the bottom two pixel rows in the cell's foreground. */
+static void draw_cursor(uint16_t index, uint16_t cell) {
+    uint32_t fg = palette[(cell >> 8) & 0x0F];
+    volatile uint32_t *dst = cell_origin(index);
+
+    dst = (volatile uint32_t *)((volatile uint8_t *)dst + (LFB_CELL_HEIGHT - 2) * lfb_pitch);
+    for (uint32_t y = 0; y < 2; y++) {
+        for (uint32_t x = 0; x < LFB_CELL_WIDTH; x++)
+            dst[x] = fg;
+        dst = (volatile uint32_t *)((volatile uint8_t *)dst + lfb_pitch);
+    }
+}
+
+/* memmove for the scroll: 32-bit moves, low to high (dst < src). */
+static inline void move_dwords(volatile void *dst, const volatile void *src, uint32_t count) {
+    __asm__ __volatile__("rep movsl"
+                         : "+D"(dst), "+S"(src), "+c"(count)
+                         :
+                         : "memory");
+}
+
+/* Move the top `region` rows up by `lines`. */
+static void scroll_pixels(uint16_t lines, uint16_t region) {
+    uint32_t cells = (uint32_t)cols * region;
+    uint32_t moved = (uint32_t)lines * cols;
+    uint32_t band = LFB_CELL_HEIGHT * lfb_pitch;
+
+    move_dwords(lfb, lfb + lines * band, (region - lines) * band / 4);
+
+    for (uint32_t i = 0; i + moved < cells; i++)
+        shown[i] = shown[i + moved];
+    for (uint32_t i = cells - moved; i < cells; i++)
+        shown[i] = NO_CELL;
+
+    if (shown_cursor != 0xFFFF && shown_cursor < cells)
+        shown_cursor = (shown_cursor >= moved) ? (uint16_t)(shown_cursor - moved) : 0xFFFF;
+}
+
+void lfb_present(const uint16_t *cells, uint16_t split, const uint16_t *split_cells,
+                 uint16_t scrolled, uint16_t cursor) {
+    uint32_t count = (uint32_t)cols * rows;
+
+    if (lfb == 0)
+        return;
+    if (split > rows)
+        split = rows;
+
+    uint32_t top = (uint32_t)cols * split;
+
+    if (scrolled >= split) {
+        for (uint32_t i = 0; i < top; i++)
+            shown[i] = NO_CELL;
+        if (shown_cursor < top)
+            shown_cursor = 0xFFFF;
+    } else if (scrolled > 0) {
+        scroll_pixels(scrolled, split);
+    }
+
+    /* The old cursor cell is redrawn plainly */
+    if (shown_cursor != 0xFFFF && shown_cursor != cursor)
+        shown[shown_cursor] = NO_CELL;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t cell = (i < top) ? cells[i] : split_cells[i - top];
+        if (shown[i] != cell) {
+            draw_cell((uint16_t)i, cell);
+            shown[i] = cell;
+            if (i == cursor)
+                shown_cursor = 0xFFFF;
+        }
+    }
+
+    if (cursor < top && shown_cursor != cursor) {
+        draw_cursor(cursor, cells[cursor]);
+        shown_cursor = cursor;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef INCLUDE_LFB_H
+#define INCLUDE_LFB_H
+
+#include "types.h"
+#include "multiboot.h"
+
+// Character cell size of the linear-framebuffer console (8x8 font, each
+// scan line drawn twice): 1024x768 gives 128x48 cells.
+#define LFB_CELL_WIDTH  8
+#define LFB_CELL_HEIGHT 16
+
+// Take over the 32 bpp RGB linear framebuffer described by the boot info.
+// Returns 0 on success, -1 if the bootloader did not provide a usable one
+// (the caller then stays in VGA text mode).
+int lfb_init(const multiboot_info_t *mbi);
+
+uint16_t lfb_cols(void);
+uint16_t lfb_rows(void);
+
+// Bring the pixels up to date with a screen of text cells (same layout as
+// VGA text memory). Like the VGA line-compare split, rows from `split` down
+// come from `split_cells` instead and never scroll. `scrolled` is how many
+// rows the text above the split moved up since the last call; those pixels
+// are moved instead of redrawn. `cursor` is a cell index, or 0xFFFF for no
+// cursor.
+void lfb_present(const uint16_t *cells, uint16_t split, const uint16_t *split_cells,
+                 uint16_t scrolled, uint16_t cursor);
+
+#endif
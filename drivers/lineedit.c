@@ -0,0 +1,431 @@
+#include "lineedit.h"
+#include "keyboard.h"
+#include "framebuffer.h"
+#include "kprintf.h"
+
+/* --- Command-name trie --- */
+
+static int trie_slot(char c) {
+    if (c >= 'a' && c <= 'z') return c - 'a';
+    if (c >= '0' && c <= '9') return 26 + (c - '0');
+    if (c == '-') return 36;
+    if (c == '_') return 37;
+    return -1;
+}
+
+static char trie_char(int slot) {
+    if (slot < 26) return (char)('a' + slot);
+    if (slot < 36) return (char)('0' + slot - 26);
+    return (slot == 36) ? '-' : '_';
+}
+
+int le_add_command(le_prompt_t *p, const char *name) {
+    le_trie_t *t = &p->commands;
+    uint8_t node = 0;
+
+    if (t->used == 0)
+        t->used = 1;    /* node 0 is the root */
+
+    for (; *name != '\0' && *name != ' '; name++) {
+        int s = trie_slot(*name);
+        if (s < 0)
+            return -1;
+        if (t->nodes[node].child[s] == 0) {
+            if (t->used >= LE_TRIE_NODES)
+                return -1;
+            t->nodes[node].child[s] = (uint8_t)t->used++;
+            t->nodes[node].nchildren++;
+        }
+        node = t->nodes[node].child[s];
+    }
+    t->nodes[node].terminal = 1;
+    return 0;
+}
+
+/* Node reached by `len` characters of `s`, or -1 */
+static int trie_find(const le_trie_t *t, const char *s, uint32_t len) {
+    uint8_t node = 0;
+
+    if (t->used == 0)
+        return -1;
+    for (uint32_t i = 0; i < len; i++) {
+        int slot = trie_slot(s[i]);
+        if (slot < 0 || t->nodes[node].child[slot] == 0)
+            return -1;
+        node = t->nodes[node].child[slot];
+    }
+    return node;
+}
+
+/* --- Editor state (one line is edited at a time) --- */
+
+static struct {
+    char *buf;
+    uint32_t max;       /* characters that fit (buffer size - 1) */
+    uint32_t len;
+    uint32_t pos;       /* edit position */
+    uint32_t cur;       /* where the screen cursor is, as a line index */
+    uint32_t shown;     /* characters currently on screen */
+    uint16_t col0;      /* screen column of index 0 */
+    uint16_t width;
+    uint8_t overwrite;
+    uint8_t last_tab;
+    uint32_t hist;      /* 0 = the line being typed, n = n-th newest entry */
+} ed;
+
+static char draft[LE_LINE_MAX];     /* the typed line while browsing history */
+static uint32_t draft_len;
+
+/* Output is collected here and written once per batch of keys */
+static char out[512];
+static uint32_t out_len;
+
+static void out_flush(void) {
+    if (out_len) {
+        fb_write_buf(out, out_len);
+        out_len = 0;
+    }
+}
+
+static void out_bytes(const char *s, uint32_t n) {
+    while (n--) {
+        if (out_len == sizeof(out))
+            out_flush();
+        out[out_len++] = *s++;
+    }
+}
+
+static void out_repeat(char c, uint32_t n) {
+    while (n--)
+        out_bytes(&c, 1);
+}
+
+static void out_csi(uint32_t n, char final) {
+    char seq[16];
+    int len = k_snprintf(seq, sizeof(seq), FB_CSI "%u%c", n, final);
+    out_bytes(seq, (uint32_t)len);
+}
+
+/* Move the screen cursor to line index `to`. The line may wrap, so this is
+ * a row change plus an absolute column.
+ */
+static void move_to(uint32_t to) {
+    uint32_t from = ed.col0 + ed.cur;
+    uint32_t dest = ed.col0 + to;
+    uint32_t from_row = from / ed.width;
+    uint32_t dest_row = dest / ed.width;
+
+    if (dest_row < from_row)
+        out_csi(from_row - dest_row, 'A');
+    else if (dest_row > from_row)
+        out_csi(dest_row - from_row, 'B');
+    if (from % ed.width != dest % ed.width)
+        out_csi(dest % ed.width + 1, 'G');
+    ed.cur = to;
+}
+
+/* Redraw the line from index `from` on (everything before it is unchanged
+ * on screen), blank what is left of a longer previous line, and put the
+ * cursor back at the edit position.
+ */
+static void repaint_from(uint32_t from) {
+    move_to(from);
+    out_bytes(ed.buf + from, ed.len - from);
+    ed.cur = ed.len;
+    if (ed.shown > ed.len) {
+        out_repeat(' ', ed.shown - ed.len);
+        ed.cur = ed.shown;
+    }
+    ed.shown = ed.len;
+    move_to(ed.pos);
+}
+
+/* Replace the line with s[0..n), repainting from the first difference */
+static void set_line(const char *s, uint32_t n) {
+    uint32_t d = 0;
+
+    if (n > ed.max)
+        n = ed.max;
+    while (d < n && d < ed.len && ed.buf[d] == s[d])
+        d++;
+    for (uint32_t i = d; i < n; i++)
+        ed.buf[i] = s[i];
+    ed.len = n;
+    ed.pos = n;
+    repaint_from(d);
+}
+
+static void insert_char(char c) {
+    if (ed.overwrite && ed.pos < ed.len) {
+        ed.buf[ed.pos] = c;
+        move_to(ed.pos);
+        out_bytes(&c, 1);
+        ed.cur = ++ed.pos;
+        return;
+    }
+    if (ed.len >= ed.max)
+        return;
+
+    for (uint32_t i = ed.len; i > ed.pos; i--)
+        ed.buf[i] = ed.buf[i - 1];
+    ed.buf[ed.pos++] = c;
+    ed.len++;
+    repaint_from(ed.pos - 1);
+}
+
+/* Remove [a, b) and leave the edit position at a */
+static void delete_range(uint32_t a, uint32_t b) {
+    if (a >= b)
+        return;
+    for (uint32_t i = b; i < ed.len; i++)
+        ed.buf[i - (b - a)] = ed.buf[i];
+    ed.len -= b - a;
+    ed.pos = a;
+    repaint_from(a);
+}
+
+static void move_edit(uint32_t pos) {
+    ed.pos = pos;
+    move_to(pos);
+}
+
+/* --- History --- */
+
+static const char *history_entry(const le_prompt_t *p, uint32_t n) {
+    return p->history[(p->history_count - n) % LE_HISTORY];
+}
+
+static uint32_t history_len(const char *s) {
+    uint32_t n = 0;
+    while (n < LE_LINE_MAX - 1 && s[n])
+        n++;
+    return n;
+}
+
+static void history_browse(le_prompt_t *p, int older) {
+    uint32_t avail = (p->history_count < LE_HISTORY) ? p->history_count : LE_HISTORY;
+
+    if (older) {
+        if (ed.hist >= avail)
+            return;
+        if (ed.hist == 0) {
+            draft_len = (ed.len < LE_LINE_MAX) ? ed.len : LE_LINE_MAX - 1;
+            for (uint32_t i = 0; i < draft_len; i++)
+                draft[i] = ed.buf[i];
+        }
+        ed.hist++;
+    } else {
+        if (ed.hist == 0)
+            return;
+        ed.hist--;
+    }
+
+    if (ed.hist == 0) {
+        set_line(draft, draft_len);
+    } else {
+        const char *s = history_entry(p, ed.hist);
+        set_line(s, history_len(s));
+    }
+}
+
+/* Remember a finished line unless it is empty or repeats the last one */
+static void history_add(le_prompt_t *p) {
+    if (ed.len == 0)
+        return;
+    if (p->history_count > 0) {
+        const char *last = history_entry(p, 1);
+        uint32_t n = history_len(last);
+        uint32_t i = 0;
+        while (i < n && i < ed.len && last[i] == ed.buf[i])
+            i++;
+        if (i == n && n == ed.len)
+            return;
+    }
+
+    char *slot = p->history[p->history_count % LE_HISTORY];
+    uint32_t n = (ed.len < LE_LINE_MAX) ? ed.len : LE_LINE_MAX - 1;
+    for (uint32_t i = 0; i < n; i++)
+        slot[i] = ed.buf[i];
+    slot[n] = '\0';
+    p->history_count++;
+}
+
+/* --- Tab completion --- */
+
+static void list_names(const le_trie_t *t, uint8_t node, char *word, uint32_t len) {
+    if (t->nodes[node].terminal) {
+        out_bytes(word, len);
+        out_bytes("  ", 2);
+    }
+    if (len >= LE_LINE_MAX - 1)
+        return;
+    for (int s = 0; s < LE_TRIE_ALPHA; s++) {
+        if (t->nodes[node].child[s]) {
+            word[len] = trie_char(s);
+            list_names(t, t->nodes[node].child[s], word, len + 1);
+        }
+    }
+}
+
+/* Complete the command name (the first word, cursor at its end) as far
+ * as it is unambiguous; with `list`, show the candidates when there is
+ * nothing to add, then redraw the prompt and line below them.
+ */
+static void complete(le_prompt_t *p, const char *prompt, uint8_t attr, int list) {
+    const le_trie_t *t = &p->commands;
+    uint32_t start = 0;
+
+    if (ed.pos != ed.len)
+        return;
+    while (start < ed.len && ed.buf[start] == ' ')
+        start++;
+    for (uint32_t i = start; i < ed.len; i++)
+        if (ed.buf[i] == ' ')
+            return;
+
+    int found = trie_find(t, ed.buf + start, ed.len - start);
+    if (found < 0)
+        return;
+
+    /* Follow single-child chains: each step adds one character */
+    uint8_t node = (uint8_t)found;
+    uint32_t added = 0;
+    while (!t->nodes[node].terminal && t->nodes[node].nchildren == 1) {
+        int s = 0;
+        while (t->nodes[node].child[s] == 0)
+            s++;
+        insert_char(trie_char(s));
+        node = t->nodes[node].child[s];
+        added++;
+    }
+
+    if (t->nodes[node].terminal && t->nodes[node].nchildren == 0) {
+        insert_char(' ');
+        return;
+    }
+    if (added || !list)
+        return;
+
+    static char word[LE_LINE_MAX];
+    uint32_t n = ed.len - start;
+    for (uint32_t i = 0; i < n; i++)
+        word[i] = ed.buf[start + i];
+
+    move_to(ed.len);
+    out_bytes("\n", 1);
+    list_names(t, node, word, n);
+    out_bytes("\n", 1);
+    out_flush();
+
+    set_color(attr & 0x0F, attr >> 4);
+    write_str(prompt);
+    ed.col0 = get_cursor_x();
+    ed.cur = 0;
+    ed.shown = 0;
+    repaint_from(0);
+}
+
+/* --- Main loop --- */
+
+#define CTRL(c) ((c) & 0x1F)
+
+/* Apply one key; returns 1 when the line is finished */
+static int handle_key(le_prompt_t *p, const char *prompt, uint8_t attr, int k) {
+    int tab = (k == '\t');
+
+    switch (k) {
+    case '\n':
+        move_to(ed.len);
+        out_bytes("\n", 1);
+        history_add(p);
+        return 1;
+    case CTRL('c'):
+        move_to(ed.len);
+        out_bytes("^C\n", 3);
+        ed.len = 0;
+        return 1;
+    case '\t':
+        complete(p, prompt, attr, ed.last_tab);
+        break;
+    case '\b':
+        if (ed.pos > 0)
+            delete_range(ed.pos - 1, ed.pos);
+        break;
+    case KBD_KEY(KEY_DELETE):
+        if (ed.pos < ed.len)
+            delete_range(ed.pos, ed.pos + 1);
+        break;
+    case CTRL('k'):
+        delete_range(ed.pos, ed.len);
+        break;
+    case CTRL('u'):
+        delete_range(0, ed.pos);
+        break;
+    case KBD_KEY(KEY_LEFT):
+        if (ed.pos > 0)
+            move_edit(ed.pos - 1);
+        break;
+    case KBD_KEY(KEY_RIGHT):
+        if (ed.pos < ed.len)
+            move_edit(ed.pos + 1);
+        break;
+    case CTRL('a'):
+    case KBD_KEY(KEY_HOME):
+        move_edit(0);
+        break;
+    case CTRL('e'):
+    case KBD_KEY(KEY_END):
+        move_edit(ed.len);
+        break;
+    case KBD_KEY(KEY_UP):
+        history_browse(p, 1);
+        break;
+    case KBD_KEY(KEY_DOWN):
+        history_browse(p, 0);
+        break;
+    case KBD_KEY(KEY_INSERT):
+        ed.overwrite = !ed.overwrite;
+        break;
+    default:
+        if (k >= ' ' && k < 0x7F)
+            insert_char((char)k);
+        break;
+    }
+
+    ed.last_tab = (uint8_t)tab;
+    return 0;
+}
+
+uint32_t le_readline(le_prompt_t *p, const char *prompt, char *buf, uint32_t max_len) {
+    uint8_t attr = fb_current_attr();
+
+    if (max_len == 0)
+        return 0;
+
+    write_str(prompt);
+
+    ed.buf = buf;
+    ed.max = max_len - 1;
+    ed.len = ed.pos = ed.cur = ed.shown = 0;
+    ed.col0 = get_cursor_x();
+    ed.width = fb_width();
+    ed.overwrite = 0;
+    ed.last_tab = 0;
+    ed.hist = 0;
+
+    for (;;) {
+        /* Apply every key already waiting, then update the screen once */
+        int k = kbd_getkey();
+        do {
+            if (handle_key(p, prompt, attr, k)) {
+                out_flush();
+                kbd_echo_done();
+                buf[ed.len] = '\0';
+                kbd_line_done();
+                return ed.len;
+            }
+        } while ((k = kbd_try_getkey()) >= 0);
+        out_flush();
+        kbd_echo_done();
+    }
+}
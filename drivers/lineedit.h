@@ -0,0 +1,47 @@
+#ifndef INCLUDE_LINEEDIT_H
+#define INCLUDE_LINEEDIT_H
+
+#include "types.h"
+
+// Line editor for the shell and app prompts: Left/Right/Home/End (also
+// Ctrl+A/Ctrl+E), Backspace/Delete, Insert toggles overwrite, Ctrl+K/Ctrl+U
+// kill to end/start, Ctrl+C abandons the line, Up/Down walk the prompt's
+// history, and Tab completes the command name (a second Tab lists the
+// candidates). Edits repaint only the part of the line after the first
+// changed character, using the console's ANSI cursor sequences, so the
+// serial mirror follows along.
+#define LE_LINE_MAX      128    // longest line kept in history
+#define LE_HISTORY       16     // history entries per prompt
+#define LE_TRIE_NODES    192    // command-name trie capacity per prompt
+#define LE_TRIE_ALPHA    38     // a-z, 0-9, '-', '_'
+
+// Prefix trie of command names: child[] is indexed by character, so
+// looking up or completing a prefix costs one step per character.
+typedef struct {
+    uint8_t child[LE_TRIE_ALPHA];   // node index, 0 = none
+    uint8_t nchildren;
+    uint8_t terminal;               // a command name ends here
+} le_trie_node_t;
+
+typedef struct {
+    le_trie_node_t nodes[LE_TRIE_NODES];
+    uint16_t used;
+} le_trie_t;
+
+// Per-prompt state: its command names and history ring. Zero-initialised
+// (static) storage is an empty prompt.
+typedef struct {
+    le_trie_t commands;
+    char history[LE_HISTORY][LE_LINE_MAX];
+    uint32_t history_count;     // lines ever added; the ring holds the last LE_HISTORY
+} le_prompt_t;
+
+// Register a command name (up to the first space). Returns -1 if it has
+// characters the trie does not index or the trie is full.
+int le_add_command(le_prompt_t *p, const char *name);
+
+// Write `prompt` (colour escapes allowed) and edit a line into buf
+// (max_len bytes including the NUL). Returns the line length.
+uint32_t le_readline(le_prompt_t *p, const char *prompt, char *buf, uint32_t max_len);
+
+#endif
@@ -3,7 +3,16 @@ extern kmain
 extern sum_of_three
 
 MAGIC_NUMBER equ 0x1BADB002
+
+%ifdef FB_GRAPHICS
+; Ask the bootloader for a linear framebuffer (flag bit 2). The address
+; fields are unused (flag bit 16 clear) but must be present so the video
+; fields land at their fixed offsets. GRUB legacy rejects this flag; boot
+; the graphics build with GRUB 2 (make GRAPHICS=1 gfx_iso).
+FLAGS equ (1 << 2)
+%else
 FLAGS equ 0
+%endif
 CHECKSUM equ -(MAGIC_NUMBER + FLAGS)
 
 section .text
@@ -12,10 +21,23 @@ align 4
 dd MAGIC_NUMBER
 dd FLAGS
 dd CHECKSUM
+%ifdef FB_GRAPHICS
+dd 0, 0, 0, 0, 0        ; header_addr .. entry_addr (unused)
+dd 0                    ; mode_type: 0 = linear graphics
+dd 1024                 ; width
+dd 768                  ; height
+dd 32                   ; depth (bits per pixel)
+%endif
 
 loader:
     mov esp, stack_top
 
+    ; kmain(magic, mbi): the bootloader leaves the magic in EAX and the
+    ; boot information pointer in EBX. Push them first; EAX does not
+    ; survive the call below.
+    push ebx
+    push eax
+
     push dword 3
     push dword 2
     push dword 1
@@ -0,0 +1,273 @@
+#include "mouse.h"
+#include "isr.h"
+#include "io.h"
+#include "framebuffer.h"
+#include "klog.h"
+
+/* 8042 controller */
+#define PS2_DATA        0x60
+#define PS2_STATUS      0x64    /* read */
+#define PS2_COMMAND     0x64    /* write */
+
+#define STATUS_OUT_FULL 0x01
+#define STATUS_IN_FULL  0x02
+
+#define CMD_READ_CONFIG   0x20
+#define CMD_WRITE_CONFIG  0x60
+#define CMD_ENABLE_AUX    0xA8
+#define CMD_WRITE_AUX     0xD4
+
+#define CONFIG_AUX_IRQ    0x02
+#define CONFIG_AUX_CLOCK  0x20  /* set = aux clock disabled */
+
+/* Mouse commands */
+#define MOUSE_SET_DEFAULTS  0xF6
+#define MOUSE_ENABLE_STREAM 0xF4
+#define MOUSE_ACK           0xFA
+
+/* First packet byte: buttons, always-one sync bit, sign and overflow bits */
+#define PKT_SYNC        0x08
+#define PKT_X_SIGN      0x10
+#define PKT_Y_SIGN      0x20
+#define PKT_OVERFLOW    0xC0
+
+#define PS2_TIMEOUT     100000
+
+static uint8_t present = 0;
+
+/* Packet assembly and pointer position, owned by the IRQ12 handler. The
+ * position is kept in motion counts so slow movement still adds up to a
+ * cell; `mouse_pos` is the cell it falls in, (y << 8 | x), which is what
+ * the reader and the framebuffer see.
+ */
+static uint8_t packet[3];
+static uint8_t packet_len = 0;
+static int32_t pos_x = 0;
+static int32_t pos_y = 0;
+static uint8_t buttons = 0;
+static volatile uint32_t mouse_pos = 0;
+
+/* Button changes, each with the cell it happened on:
+ * (buttons << 16) | (y << 8) | x. Single producer (IRQ12), single
+ * consumer (mouse_poll), free-running indices as in the keyboard queue.
+ */
+static uint32_t ev_queue[MOUSE_QUEUE_SIZE];
+static volatile uint32_t ev_head = 0;
+static volatile uint32_t ev_tail = 0;
+
+static mouse_stats_t stats;
+
+#define BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/* Selection state, owned by mouse_poll */
+static uint8_t selecting = 0;       /* left button went down on this console */
+static uint8_t dragged = 0;         /* a selection has been started */
+static uint32_t anchor = 0;         /* cell the button went down on */
+static uint32_t applied = 0;        /* cell last passed to the selection */
+static char clip[MOUSE_CLIP_MAX];
+
+static int wait_write(void) {
+    for (uint32_t i = 0; i < PS2_TIMEOUT; i++)
+        if (!(inb(PS2_STATUS) & STATUS_IN_FULL))
+            return 0;
+    return -1;
+}
+
+static int wait_read(void) {
+    for (uint32_t i = 0; i < PS2_TIMEOUT; i++)
+        if (inb(PS2_STATUS) & STATUS_OUT_FULL)
+            return 0;
+    return -1;
+}
+
+/* Send a command byte to the mouse and wait for its acknowledgement */
+static int aux_command(uint8_t cmd) {
+    if (wait_write() < 0) return -1;
+    outb(PS2_COMMAND, CMD_WRITE_AUX);
+    if (wait_write() < 0) return -1;
+    outb(PS2_DATA, cmd);
+    if (wait_read() < 0) return -1;
+    return inb(PS2_DATA) == MOUSE_ACK ? 0 : -1;
+}
+
+static int32_t clamp(int32_t v, int32_t max) {
+    if (v < 0) return 0;
+    if (v > max) return max;
+    return v;
+}
+
+/* Fold one complete packet into the pointer state */
+static void handle_packet(void) {
+    uint8_t b0 = packet[0];
+    stats.packets++;
+
+    if (!(b0 & PKT_OVERFLOW)) {
+        int32_t dx = packet[1] - ((b0 & PKT_X_SIGN) ? 0x100 : 0);
+        int32_t dy = packet[2] - ((b0 & PKT_Y_SIGN) ? 0x100 : 0);
+        pos_x = clamp(pos_x + dx, (int32_t)fb_width() * MOUSE_X_MICKEYS - 1);
+        pos_y = clamp(pos_y - dy, (int32_t)fb_height() * MOUSE_Y_MICKEYS - 1);  /* +y is up */
+    }
+
+    uint32_t x = (uint32_t)pos_x / MOUSE_X_MICKEYS;
+    uint32_t y = (uint32_t)pos_y / MOUSE_Y_MICKEYS;
+    uint32_t cell = y << 8 | x;
+    uint8_t now = b0 & (MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE);
+    int changed = 0;
+
+    if (cell != mouse_pos) {
+        mouse_pos = cell;
+        fb_pointer_move((uint16_t)x, (uint16_t)y);
+        stats.moves++;
+        changed = 1;
+    }
+
+    if (now != buttons) {
+        buttons = now;
+        changed = 1;
+        uint32_t head = ev_head;
+        if (head - ev_tail >= MOUSE_QUEUE_SIZE) {
+            stats.dropped++;
+        } else {
+            ev_queue[head & (MOUSE_QUEUE_SIZE - 1)] = (uint32_t)now << 16 | cell;
+            BARRIER();
+            ev_head = head + 1;
+        }
+    }
+
+    if (!changed)
+        stats.coalesced++;
+}
+
+/* IRQ12: one byte of a packet. A first byte without the sync bit means we
+ * lost track of the packet boundaries; drop bytes until one has it.
+ */
+static void mouse_callback(registers_t *regs) {
+    (void)regs;
+
+    if (!(inb(PS2_STATUS) & STATUS_OUT_FULL))
+        return;
+    uint8_t b = inb(PS2_DATA);
+
+    if (packet_len == 0 && !(b & PKT_SYNC)) {
+        stats.resyncs++;
+        return;
+    }
+    packet[packet_len++] = b;
+    if (packet_len == 3) {
+        packet_len = 0;
+        handle_packet();
+    }
+}
+
+int init_mouse(void) {
+    /* Enable the aux port, its interrupt and its clock */
+    if (wait_write() < 0) return -1;
+    outb(PS2_COMMAND, CMD_ENABLE_AUX);
+
+    if (wait_write() < 0) return -1;
+    outb(PS2_COMMAND, CMD_READ_CONFIG);
+    if (wait_read() < 0) return -1;
+    uint8_t config = inb(PS2_DATA);
+    config = (uint8_t)((config | CONFIG_AUX_IRQ) & ~CONFIG_AUX_CLOCK);
+    if (wait_write() < 0) return -1;
+    outb(PS2_COMMAND, CMD_WRITE_CONFIG);
+    if (wait_write() < 0) return -1;
+    outb(PS2_DATA, config);
+
+    if (aux_command(MOUSE_SET_DEFAULTS) < 0 || aux_command(MOUSE_ENABLE_STREAM) < 0)
+        return -1;
+
+    /* Start in the middle of the screen */
+    pos_x = (int32_t)fb_width() * MOUSE_X_MICKEYS / 2;
+    pos_y = (int32_t)fb_height() * MOUSE_Y_MICKEYS / 2;
+    mouse_pos = 0xFFFFFFFFu;
+    present = 1;
+
+    register_interrupt_handler(IRQ12, mouse_callback);
+
+    /* Unmask IRQ12 (and on the 8259s the cascade) */
+    irq_unmask(12);
+    return 0;
+}
+
+int mouse_present(void) {
+    return present;
+}
+
+static inline uint16_t cell_x(uint32_t cell) { return (uint16_t)(cell & 0xFF); }
+static inline uint16_t cell_y(uint32_t cell) { return (uint16_t)((cell >> 8) & 0xFF); }
+
+/* Move the free end of the selection to `cell`. The first move away from
+ * the cell the button went down on starts the selection there.
+ */
+static void drag_to(uint32_t cell) {
+    if (cell == applied)
+        return;
+    applied = cell;
+
+    if (!dragged) {
+        if (cell == anchor)
+            return;
+        dragged = 1;
+        framebuffer_highlight_region(cell_x(anchor), cell_y(anchor), cell_x(cell), cell_y(cell));
+    } else {
+        framebuffer_extend_selection(cell_x(cell), cell_y(cell));
+    }
+}
+
+/* A left button change on `cell`. Selections are made on the console that
+ * receives output, so only while it is the one displayed.
+ */
+static void left_button(int down, uint32_t cell) {
+    if (down) {
+        selecting = fb_console_shown() == fb_console_current();
+        if (!selecting)
+            return;
+        framebuffer_clear_selection();
+        dragged = 0;
+        anchor = applied = cell;
+    } else if (selecting) {
+        drag_to(cell);
+        selecting = 0;
+        if (dragged)
+            framebuffer_copy_selection(clip, sizeof(clip));
+    }
+}
+
+void mouse_poll(void) {
+    static uint8_t last_buttons = 0;
+
+    if (!present)
+        return;
+    if (ev_tail == ev_head && !(selecting && mouse_pos != applied))
+        return;
+    stats.polls++;
+
+    uint32_t tail = ev_tail;
+    while (tail != ev_head) {
+        BARRIER();
+        uint32_t e = ev_queue[tail & (MOUSE_QUEUE_SIZE - 1)];
+        BARRIER();
+        ev_tail = ++tail;
+
+        uint8_t now = (uint8_t)(e >> 16);
+        uint32_t cell = e & 0xFFFF;
+        if ((now ^ last_buttons) & MOUSE_LEFT)
+            left_button(now & MOUSE_LEFT, cell);
+        else if (selecting)
+            drag_to(cell);
+        last_buttons = now;
+    }
+
+    /* All motion since the last call, as one update */
+    if (selecting)
+        drag_to(mouse_pos);
+}
+
+const char *mouse_clipboard(void) {
+    return clip;
+}
+
+void mouse_get_stats(mouse_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,49 @@
+#ifndef INCLUDE_MOUSE_H
+#define INCLUDE_MOUSE_H
+
+#include "types.h"
+
+// PS/2 mouse on the 8042 auxiliary port (IRQ12), driving a text-mode
+// pointer and click-drag selection on the displayed console.
+//
+// The IRQ handler assembles 3-byte packets and folds their motion into
+// one pointer position, kept in cell units. A packet that leaves the
+// pointer on the same cell with the same buttons changes nothing else;
+// only button changes are queued, so a fast drag costs the reader one
+// selection update per wake-up however many packets arrived.
+#define MOUSE_QUEUE_SIZE  32    // button events (power of two)
+#define MOUSE_X_MICKEYS   8     // motion counts per column
+#define MOUSE_Y_MICKEYS   16    // motion counts per row
+#define MOUSE_CLIP_MAX    2048  // bytes kept from the last selection
+
+#define MOUSE_LEFT    0x01
+#define MOUSE_RIGHT   0x02
+#define MOUSE_MIDDLE  0x04
+
+// Enable the aux port and streaming, unmask IRQ12. Call with interrupts
+// off; returns -1 if no mouse answers.
+int init_mouse(void);
+int mouse_present(void);
+
+// Apply what the handler recorded since the last call: left button
+// press/drag/release selects text on the displayed console, and the
+// release copies it to the clip buffer. Main context; returns
+// immediately when nothing changed.
+void mouse_poll(void);
+
+// Text of the last completed selection ("" if none)
+const char *mouse_clipboard(void);
+
+// Counters for diagnostics
+typedef struct {
+    uint32_t packets;       /* complete packets received */
+    uint32_t moves;         /* packets that moved the pointer to another cell */
+    uint32_t coalesced;     /* packets absorbed without a visible change */
+    uint32_t resyncs;       /* bytes discarded to find a packet start */
+    uint32_t dropped;       /* button events lost to a full queue */
+    uint32_t polls;         /* mouse_poll() calls that had work */
+} mouse_stats_t;
+
+void mouse_get_stats(mouse_stats_t *out);
+
+#endif
@@ -0,0 +1,294 @@
+#include "replay.h"
+#include "keyboard.h"
+#include "timer.h"
+#include "kprintf.h"
+
+/* Directive names shared by the script parser and the recorder. Entries
+ * with a character code type that character; the others a KBD_KEY().
+ */
+static const struct {
+    const char *name;
+    int key;
+} key_names[] = {
+    { "up",    KBD_KEY(KEY_UP) },
+    { "down",  KBD_KEY(KEY_DOWN) },
+    { "left",  KBD_KEY(KEY_LEFT) },
+    { "right", KBD_KEY(KEY_RIGHT) },
+    { "home",  KBD_KEY(KEY_HOME) },
+    { "end",   KBD_KEY(KEY_END) },
+    { "ins",   KBD_KEY(KEY_INSERT) },
+    { "del",   KBD_KEY(KEY_DELETE) },
+    { "pgup",  KBD_KEY(KEY_PAGE_UP) },
+    { "pgdn",  KBD_KEY(KEY_PAGE_DOWN) },
+    { "tab",   '\t' },
+    { "bs",    '\b' },
+    { "esc",   0x1B },
+    { "enter", '\n' },
+};
+
+#define KEY_NAMES (sizeof(key_names) / sizeof(key_names[0]))
+
+/* Playback state. Main context only writes it while `playing` is 0, and
+ * the timer softirq cannot run in the middle of a main-context update of
+ * `playing` (a single byte store), so no lock is needed.
+ */
+static const char *script = 0;
+static uint32_t script_len = 0;
+static uint32_t script_pos = 0;
+static uint32_t delay_ticks = 0;
+static uint32_t next_tick = 0;
+static volatile uint8_t playing = 0;
+static uint32_t keys_sent = 0;
+static uint32_t skipped = 0;
+
+/* Recording state (main context) */
+static char record_buf[REPLAY_RECORD_MAX];
+static uint32_t record_len = 0;
+static uint8_t recording = 0;
+static uint32_t record_tick = 0;
+
+/* Timer ticks for `ms` milliseconds, rounded up */
+static uint32_t ms_to_ticks(uint32_t ms) {
+    uint32_t hz = timer_get_hz();
+    if (ms > 600000)
+        ms = 600000;
+    return (ms * hz + 999) / 1000;
+}
+
+static int name_is(const char *s, uint32_t len, const char *name) {
+    uint32_t i = 0;
+    for (; i < len && name[i]; i++)
+        if (s[i] != name[i])
+            return 0;
+    return i == len && name[i] == '\0';
+}
+
+/* Decimal or 0x hex number in s[0..len) */
+static uint32_t parse_number(const char *s, uint32_t len) {
+    uint32_t v = 0;
+    uint32_t i = 0;
+
+    if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        for (i = 2; i < len; i++) {
+            char c = s[i];
+            uint32_t d = (c >= '0' && c <= '9') ? (uint32_t)(c - '0')
+                       : (c >= 'a' && c <= 'f') ? (uint32_t)(c - 'a' + 10)
+                       : (c >= 'A' && c <= 'F') ? (uint32_t)(c - 'A' + 10) : 16;
+            if (d > 15)
+                break;
+            v = v * 16 + d;
+        }
+        return v;
+    }
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+        v = v * 10 + (uint32_t)(s[i] - '0');
+    return v;
+}
+
+/* One script item starting at script_pos */
+#define ITEM_KEY    0
+#define ITEM_WAIT   1
+#define ITEM_DELAY  2
+#define ITEM_SKIP   3
+
+typedef struct {
+    uint8_t  type;
+    uint32_t size;      /* script bytes it takes */
+    int      key;       /* ITEM_KEY */
+    uint32_t ms;        /* ITEM_WAIT / ITEM_DELAY */
+} item_t;
+
+static void next_item(item_t *it) {
+    const char *s = script + script_pos;
+    uint32_t left = script_len - script_pos;
+
+    it->type = ITEM_KEY;
+    it->size = 1;
+    it->key = (uint8_t)s[0];
+    it->ms = 0;
+
+    if (s[0] == '\r') {
+        it->type = ITEM_SKIP;
+        return;
+    }
+    if (s[0] != '{')
+        return;
+    if (left > 1 && s[1] == '{') {
+        it->size = 2;
+        return;
+    }
+
+    /* {name} or {name arg} */
+    uint32_t end = 1;
+    while (end < left && s[end] != '}' && s[end] != '\n')
+        end++;
+    if (end == left || s[end] != '}') {
+        it->type = ITEM_SKIP;       /* unterminated: drop the brace */
+        skipped++;
+        return;
+    }
+    it->size = end + 1;
+
+    const char *name = s + 1;
+    uint32_t name_len = 0;
+    while (name_len < end - 1 && name[name_len] != ' ')
+        name_len++;
+    const char *arg = name + name_len;
+    uint32_t arg_len = end - 1 - name_len;
+    while (arg_len && *arg == ' ') {
+        arg++;
+        arg_len--;
+    }
+
+    if (name_is(name, name_len, "wait")) {
+        it->type = ITEM_WAIT;
+        it->ms = parse_number(arg, arg_len);
+    } else if (name_is(name, name_len, "delay")) {
+        it->type = ITEM_DELAY;
+        it->ms = parse_number(arg, arg_len);
+    } else if (name_is(name, name_len, "key")) {
+        it->key = KBD_KEY(parse_number(arg, arg_len) & 0xFF);
+    } else if (name_len == 6 && name_is(name, 5, "ctrl-") &&
+               (name[5] | 0x20) >= 'a' && (name[5] | 0x20) <= 'z') {
+        it->key = (name[5] | 0x20) & 0x1F;
+    } else {
+        it->type = ITEM_SKIP;
+        for (uint32_t i = 0; i < KEY_NAMES; i++)
+            if (name_is(name, name_len, key_names[i].name)) {
+                it->type = ITEM_KEY;
+                it->key = key_names[i].key;
+            }
+        if (it->type == ITEM_SKIP)
+            skipped++;
+    }
+}
+
+/* Timer hook: queue every key that is due, stopping at a pause or when
+ * the input queue is full (the key is retried on the next tick).
+ */
+void replay_tick(uint32_t ticks) {
+    if (!playing || (int32_t)(ticks - next_tick) < 0)
+        return;
+
+    item_t it;
+    while (script_pos < script_len) {
+        next_item(&it);
+
+        if (it.type == ITEM_KEY) {
+            int r = kbd_inject(it.key);
+            if (r == -1)
+                return;
+            if (r == 0)
+                keys_sent++;
+            else
+                skipped++;
+            script_pos += it.size;
+            if (delay_ticks) {
+                next_tick = ticks + delay_ticks;
+                return;
+            }
+            continue;
+        }
+
+        script_pos += it.size;
+        if (it.type == ITEM_DELAY) {
+            delay_ticks = ms_to_ticks(it.ms);
+        } else if (it.type == ITEM_WAIT) {
+            next_tick = ticks + ms_to_ticks(it.ms);
+            return;
+        }
+    }
+    playing = 0;
+}
+
+int replay_start(const char *text, uint32_t len) {
+    if (playing)
+        return -1;
+
+    script = text;
+    script_len = len;
+    script_pos = 0;
+    delay_ticks = 0;
+    next_tick = timer_get_ticks();
+    keys_sent = 0;
+    skipped = 0;
+    __asm__ __volatile__("" ::: "memory");
+    playing = 1;
+    return 0;
+}
+
+void replay_stop(void) {
+    playing = 0;
+}
+
+/* --- Recording --- */
+
+static void record_append(const char *s, uint32_t len) {
+    if (record_len + len > REPLAY_RECORD_MAX)
+        return;
+    for (uint32_t i = 0; i < len; i++)
+        record_buf[record_len++] = s[i];
+}
+
+void replay_record(int on) {
+    if (on) {
+        record_len = 0;
+        record_tick = timer_get_ticks();
+    }
+    recording = (uint8_t)(on != 0);
+}
+
+/* Append `k` to the recording as script text, preceded by the pause since
+ * the previous key if it was long enough to matter.
+ */
+void replay_note_key(int k) {
+    char text[24];
+    int n = 0;
+
+    if (!recording)
+        return;
+
+    uint32_t now = timer_get_ticks();
+    uint32_t hz = timer_get_hz();
+    uint32_t gap = now - record_tick;
+    record_tick = now;
+    if (hz && gap < 0xFFFFFFFFu / 1000) {
+        uint32_t ms = gap * 1000 / hz;
+        if (ms >= REPLAY_MIN_WAIT_MS) {
+            n = k_snprintf(text, sizeof(text), "{wait %u}", ms);
+            record_append(text, (uint32_t)n);
+        }
+    }
+
+    n = 0;
+    if (k == '{') {
+        n = k_snprintf(text, sizeof(text), "{{");
+    } else if ((k >= ' ' && k < 0x7F) || k == '\n') {
+        text[0] = (char)k;
+        n = 1;
+    } else {
+        for (uint32_t i = 0; i < KEY_NAMES && n == 0; i++)
+            if (key_names[i].key == k)
+                n = k_snprintf(text, sizeof(text), "{%s}", key_names[i].name);
+        if (n == 0 && k >= 1 && k <= 26)
+            n = k_snprintf(text, sizeof(text), "{ctrl-%c}", 'a' + k - 1);
+        if (n == 0 && k >= 0x100)
+            n = k_snprintf(text, sizeof(text), "{key 0x%x}", k & 0xFF);
+    }
+    record_append(text, (uint32_t)n);
+}
+
+const char *replay_recording(uint32_t *len) {
+    *len = record_len;
+    return record_buf;
+}
+
+void replay_get_status(replay_status_t *out) {
+    out->playing = playing;
+    out->recording = recording;
+    out->pos = script_pos;
+    out->len = script_len;
+    out->keys = keys_sent;
+    out->skipped = skipped;
+    out->recorded = record_len;
+}
@@ -0,0 +1,48 @@
+#ifndef INCLUDE_REPLAY_H
+#define INCLUDE_REPLAY_H
+
+#include "types.h"
+
+// Keystroke replay and recording.
+//
+// A key script is text typed as it stands (a newline is Enter) with
+// directives in braces:
+//   {wait N}    pause N ms before the next key
+//   {delay N}   pause N ms after every key from here on (0, the default,
+//               sends keys as fast as the input queue takes them)
+//   {up} {down} {left} {right} {home} {end} {ins} {del} {pgup} {pgdn}
+//   {tab} {bs} {esc} {enter}
+//   {ctrl-x}    Ctrl+letter
+//   {key N}     raw keycode N (see keyboard.h; decimal or 0x hex)
+//   {{          a literal '{'
+// '\r' is ignored, so CRLF files work. The timer softirq feeds the keys
+// into the keyboard input queue, so readers cannot tell them from typing;
+// timing has the resolution of one tick.
+#define REPLAY_RECORD_MAX  8192     // bytes of recorded script
+#define REPLAY_MIN_WAIT_MS 50       // shorter gaps are not recorded
+
+// Playback of `len` bytes at `script` (kept in place, not copied).
+// Returns -1 if a replay is already running.
+int replay_start(const char *script, uint32_t len);
+void replay_stop(void);
+void replay_tick(uint32_t ticks);   // timer softirq
+
+// Recording: every key handed to a reader is appended to a script, with
+// {wait N} for pauses. replay_recording() returns the text and its length.
+void replay_record(int on);
+void replay_note_key(int k);        // called by the keyboard reader
+const char *replay_recording(uint32_t *len);
+
+typedef struct {
+    uint8_t  playing;
+    uint8_t  recording;
+    uint32_t pos;           /* script bytes consumed */
+    uint32_t len;
+    uint32_t keys;          /* keys queued by the current or last replay */
+    uint32_t skipped;       /* unknown directives and untypeable characters */
+    uint32_t recorded;      /* bytes in the recording */
+} replay_status_t;
+
+void replay_get_status(replay_status_t *out);
+
+#endif
@@ -0,0 +1,254 @@
+#include "serial.h"
+#include "isr.h"
+#include "io.h"
+#include "irqflags.h"
+
+/* 16550 registers (offsets from the base port) */
+#define UART_DATA   0   /* RBR/THR, DLL while DLAB=1 */
+#define UART_IER    1   /* interrupt enable, DLM while DLAB=1 */
+#define UART_IIR    2   /* interrupt identification (read) */
+#define UART_FCR    2   /* FIFO control (write) */
+#define UART_LCR    3
+#define UART_MCR    4
+#define UART_LSR    5
+#define UART_MSR    6
+#define UART_SCR    7
+
+#define IER_RX      0x01    /* received data available / timeout */
+#define IER_THRE    0x02    /* transmit holding register empty */
+#define IER_LINE    0x04    /* line status */
+
+#define IIR_NONE    0x01    /* no interrupt pending */
+#define IIR_ID      0x0E
+#define IIR_MSR     0x00
+#define IIR_THRE    0x02
+#define IIR_RX      0x04
+#define IIR_LINE    0x06
+#define IIR_TIMEOUT 0x0C
+
+#define LCR_8N1     0x03
+#define LCR_DLAB    0x80
+#define FCR_ENABLE  0xC7    /* enable, clear both FIFOs, 14-byte RX trigger */
+#define MCR_OUT2    0x0B    /* DTR | RTS | OUT2 (OUT2 gates the IRQ line) */
+#define LSR_DR      0x01
+#define LSR_THRE    0x20
+
+#define UART_CLOCK  115200
+#define UART_FIFO   16      /* bytes the TX FIFO takes after THR-empty */
+
+static uint16_t port = SERIAL_COM1;
+static uint8_t present = 0;
+static uint8_t ier = 0;
+
+/* TX ring: filled by serial_write() inside a short IRQ-disabled window
+ * (several contexts may write), drained by the IRQ handler. RX ring: filled
+ * by the IRQ handler, drained by serial_getc() in the main context.
+ * Indices run free and are reduced modulo the (power of two) size.
+ */
+static char tx_buf[SERIAL_TX_BUFFER];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+static char rx_buf[SERIAL_RX_BUFFER];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+static serial_stats_t stats;
+
+/* Enable or disable the THR-empty interrupt. Enabling it while the FIFO is
+ * already empty raises the interrupt at once, which starts transmission.
+ */
+static inline void set_thre(int on) {
+    uint8_t v = on ? (ier | IER_THRE) : (ier & ~IER_THRE);
+    if (v != ier) {
+        ier = v;
+        outb(port + UART_IER, ier);
+    }
+}
+
+static void receive(void) {
+    while (inb(port + UART_LSR) & LSR_DR) {
+        char c = (char)inb(port + UART_DATA);
+        uint32_t head = rx_head;
+        if (head - rx_tail >= SERIAL_RX_BUFFER) {
+            stats.rx_dropped++;
+            continue;
+        }
+        rx_buf[head % SERIAL_RX_BUFFER] = c;
+        __asm__ __volatile__("" ::: "memory");
+        rx_head = head + 1;
+        stats.rx_bytes++;
+    }
+}
+
+/* The FIFO is empty: refill it with up to UART_FIFO bytes in one burst,
+ * or stop the THR-empty interrupt when there is nothing left to send.
+ */
+static void transmit(void) {
+    uint32_t tail = tx_tail;
+    uint32_t n = 0;
+
+    while (n < UART_FIFO && tail != tx_head) {
+        outb(port + UART_DATA, (uint8_t)tx_buf[tail % SERIAL_TX_BUFFER]);
+        tail++;
+        n++;
+    }
+    tx_tail = tail;
+    stats.tx_bytes += n;
+
+    if (n)
+        stats.tx_bursts++;
+    if (tail == tx_head)
+        set_thre(0);
+}
+
+/* IRQ4: service every pending cause until the UART reports none. */
+static void serial_callback(registers_t *regs) {
+    (void)regs;
+
+    for (;;) {
+        uint8_t iir = inb(port + UART_IIR);
+        if (iir & IIR_NONE)
+            break;
+
+        switch (iir & IIR_ID) {
+        case IIR_RX:
+        case IIR_TIMEOUT:
+            receive();
+            break;
+        case IIR_THRE:
+            transmit();
+            break;
+        case IIR_LINE:
+            (void)inb(port + UART_LSR);
+            break;
+        default:
+            (void)inb(port + UART_MSR);
+            break;
+        }
+    }
+}
+
+int init_serial(uint32_t baud) {
+    if (baud == 0 || baud > UART_CLOCK)
+        baud = UART_CLOCK;
+    uint16_t divisor = (uint16_t)(UART_CLOCK / baud);
+
+    /* No UART behind the port if the scratch register doesn't hold a value */
+    outb(port + UART_SCR, 0xA5);
+    if (inb(port + UART_SCR) != 0xA5)
+        return -1;
+
+    outb(port + UART_IER, 0);
+    outb(port + UART_LCR, LCR_DLAB);
+    outb(port + UART_DATA, divisor & 0xFF);
+    outb(port + UART_IER, (divisor >> 8) & 0xFF);
+    outb(port + UART_LCR, LCR_8N1);
+    outb(port + UART_FCR, FCR_ENABLE);
+    outb(port + UART_MCR, MCR_OUT2);
+
+    /* Drop anything left over from before the FIFOs were cleared */
+    (void)inb(port + UART_LSR);
+    (void)inb(port + UART_DATA);
+    (void)inb(port + UART_IIR);
+    (void)inb(port + UART_MSR);
+
+    register_interrupt_handler(IRQ4, serial_callback);
+    ier = IER_RX | IER_LINE;
+    outb(port + UART_IER, ier);
+
+    /* Unmask IRQ4 on the PIC or I/O APIC */
+    irq_unmask(4);
+
+    present = 1;
+    return 0;
+}
+
+int serial_present(void) {
+    return present;
+}
+
+void serial_write(const char *s, uint32_t len) {
+    if (!present)
+        return;
+
+    while (len > 0) {
+        /* Copy at most 256 bytes per IRQ-disabled window */
+        uint32_t flags = irq_save();
+        uint32_t room = SERIAL_TX_BUFFER - (tx_head - tx_tail);
+        uint32_t n = (len < room) ? len : room;
+        if (n > 256)
+            n = 256;
+
+        uint32_t head = tx_head;
+        for (uint32_t i = 0; i < n; i++)
+            tx_buf[(head + i) % SERIAL_TX_BUFFER] = s[i];
+        tx_head = head + n;
+        if (n)
+            set_thre(1);
+        irq_restore(flags);
+
+        s += n;
+        len -= n;
+        if (len == 0)
+            break;
+
+        if (n == 0) {
+            /* Ring full: wait for the IRQ handler to make room, unless it
+             * cannot run (we are in a handler or critical section).
+             */
+            if (!(flags & EFLAGS_IF)) {
+                stats.tx_dropped += len;
+                return;
+            }
+            __asm__ __volatile__("pause");
+        }
+    }
+}
+
+void serial_flush(void) {
+    if (!present)
+        return;
+
+    while (tx_tail != tx_head) {
+        while (!(inb(port + UART_LSR) & LSR_THRE))
+            __asm__ __volatile__("pause");
+        transmit();
+    }
+}
+
+void serial_console_write(const char *s, uint32_t len) {
+    const char *run = s;
+    const char *end = s + len;
+
+    for (; s < end; s++) {
+        if (*s != '\n' && *s != '\b')
+            continue;
+        serial_write(run, (uint32_t)(s - run));
+        if (*s == '\n')
+            serial_write("\r\n", 2);
+        else
+            serial_write("\b \b", 3);
+        run = s + 1;
+    }
+    serial_write(run, (uint32_t)(end - run));
+}
+
+int serial_getc(void) {
+    uint32_t tail = rx_tail;
+    if (tail == rx_head)
+        return -1;
+
+    __asm__ __volatile__("" ::: "memory");
+    char c = rx_buf[tail % SERIAL_RX_BUFFER];
+    rx_tail = tail + 1;
+    return (uint8_t)c;
+}
+
+uint32_t serial_rx_pending(void) {
+    return rx_head - rx_tail;
+}
+
+void serial_get_stats(serial_stats_t *out) {
+    *out = stats;
+}
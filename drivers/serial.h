@@ -0,0 +1,45 @@
+#ifndef INCLUDE_SERIAL_H
+#define INCLUDE_SERIAL_H
+
+#include "types.h"
+
+// 16550 UART on COM1 (I/O 0x3F8, IRQ4), interrupt driven in both directions.
+#define SERIAL_COM1       0x3F8
+#define SERIAL_TX_BUFFER  8192
+#define SERIAL_RX_BUFFER  4096
+
+// Program COM1 for `baud` 8N1 with the FIFOs enabled and unmask IRQ4.
+// Returns -1 if no UART answers (the other functions then do nothing).
+int init_serial(uint32_t baud);
+int serial_present(void);
+
+// Queue bytes for transmission; the IRQ handler sends them a FIFO-full at
+// a time. Blocks while the ring is full if interrupts are enabled,
+// otherwise (IRQ context) drops what does not fit.
+void serial_write(const char *s, uint32_t len);
+
+// Send everything queued by polling the UART, for when the IRQ handler
+// cannot run any more (a fatal exception with interrupts off).
+void serial_flush(void);
+
+// Console mirror (see fb_set_mirror): like serial_write, but '\n' becomes
+// "\r\n" and '\b' becomes "\b \b" so a terminal erases the character.
+void serial_console_write(const char *s, uint32_t len);
+
+// Next received byte, or -1 if none is waiting. Main context.
+int serial_getc(void);
+// Number of received bytes waiting
+uint32_t serial_rx_pending(void);
+
+// Counters for diagnostics
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t rx_dropped;     /* RX ring full */
+    uint32_t tx_dropped;     /* TX ring full in IRQ context */
+    uint32_t tx_bursts;      /* THR-empty interrupts that refilled the FIFO */
+} serial_stats_t;
+
+void serial_get_stats(serial_stats_t *out);
+
+#endif
@@ -0,0 +1,110 @@
+#include "softirq.h"
+#include "irqflags.h"
+#include "tsc.h"
+
+static softirq_fn_t handlers[SOFTIRQ_COUNT];
+static softirq_stat_t stats[SOFTIRQ_COUNT];
+static uint64_t raised_at[SOFTIRQ_COUNT];   /* TSC of the raise that made it pending */
+static uint32_t deferred = 0;
+
+/* Both only change with interrupts off */
+static volatile uint32_t pending = 0;
+static volatile uint8_t running = 0;
+
+static inline uint32_t clamp32(uint64_t v) {
+    return (v >> 32) ? 0xFFFFFFFFu : (uint32_t)v;
+}
+
+void register_softirq(uint8_t nr, const char *name, softirq_fn_t fn) {
+    if (nr >= SOFTIRQ_COUNT)
+        return;
+    stats[nr].name = name;
+    handlers[nr] = fn;
+}
+
+void softirq_raise(uint8_t nr) {
+    if (nr >= SOFTIRQ_COUNT)
+        return;
+
+    uint32_t flags = irq_save();
+    if (!(pending & (1u << nr))) {
+        pending |= 1u << nr;
+        raised_at[nr] = rdtsc();
+    }
+    stats[nr].raised++;
+    irq_restore(flags);
+}
+
+int softirq_pending(void) {
+    return pending != 0;
+}
+
+/* Each pass takes the pending set with interrupts off, then runs it with
+ * them on; what the handlers raise meanwhile is picked up by the next pass.
+ */
+void softirq_run(void) {
+    uint64_t since[SOFTIRQ_COUNT];
+
+    uint32_t flags = irq_save();
+    if (running || !pending) {
+        irq_restore(flags);
+        return;
+    }
+    running = 1;
+
+    for (uint32_t pass = 0; pending && pass < SOFTIRQ_PASSES; pass++) {
+        uint32_t work = pending;
+        pending = 0;
+        for (uint8_t nr = 0; nr < SOFTIRQ_COUNT; nr++)
+            since[nr] = raised_at[nr];
+        __asm__ __volatile__("sti" ::: "memory");
+
+        for (uint8_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if (!(work & (1u << nr)) || handlers[nr] == 0)
+                continue;
+            softirq_stat_t *st = &stats[nr];
+            uint64_t t0 = rdtsc();
+            handlers[nr]();
+            uint64_t t1 = rdtsc();
+
+            uint32_t wait = clamp32(t0 - since[nr]);
+            uint32_t took = clamp32(t1 - t0);
+            st->runs++;
+            st->cycles += took;
+            if (wait > st->max_latency)
+                st->max_latency = wait;
+            if (took > st->max_cycles)
+                st->max_cycles = took;
+        }
+
+        __asm__ __volatile__("cli" ::: "memory");
+    }
+    if (pending)
+        deferred++;
+
+    running = 0;
+    irq_restore(flags);
+}
+
+void softirq_get_stat(uint8_t nr, softirq_stat_t *out) {
+    uint32_t flags = irq_save();
+    *out = stats[nr < SOFTIRQ_COUNT ? nr : 0];
+    irq_restore(flags);
+}
+
+uint32_t softirq_deferred(void) {
+    return deferred;
+}
+
+void softirq_reset_stats(void) {
+    uint32_t flags = irq_save();
+    for (uint8_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        stats[nr].raised = 0;
+        stats[nr].runs = 0;
+        stats[nr].max_latency = 0;
+        stats[nr].max_cycles = 0;
+        stats[nr].cycles = 0;
+    }
+    deferred = 0;
+    irq_restore(flags);
+}
@@ -0,0 +1,52 @@
+#ifndef INCLUDE_SOFTIRQ_H
+#define INCLUDE_SOFTIRQ_H
+
+#include "types.h"
+
+// Deferred interrupt work ("softirqs"). A handler does only what has to
+// happen with interrupts off (read the device, note the time) and raises
+// a softirq for the rest. Pending softirqs run with interrupts enabled
+// when an IRQ returns to code that had them enabled, and in the idle loop
+// before `hlt`.
+//
+// Softirqs never nest or run concurrently with each other, so one that
+// feeds a single-producer queue stays its only producer. Interrupt
+// handlers can preempt them, and they can in turn interrupt the main
+// context anywhere, so they stick to the IRQ-safe APIs.
+enum {
+    SOFTIRQ_KEYBOARD,   // scancode decoding (keyboard.c)
+    SOFTIRQ_TIMER,      // tick work: status line, replay, console flush (timer.c)
+    SOFTIRQ_COUNT       // lower numbers run first
+};
+
+// Passes over the pending set per run; work raised after the last pass
+// waits for the next IRQ exit or the idle loop
+#define SOFTIRQ_PASSES 4
+
+typedef void (*softirq_fn_t)(void);
+
+void register_softirq(uint8_t nr, const char *name, softirq_fn_t fn);
+
+// Mark `nr` pending (any context). Raising it again before it runs only
+// counts; it runs once.
+void softirq_raise(uint8_t nr);
+int softirq_pending(void);
+
+// Run everything pending. Returns at once if softirqs are already running
+// further down the stack.
+void softirq_run(void);
+
+typedef struct {
+    const char *name;
+    uint32_t raised;        /* softirq_raise() calls */
+    uint32_t runs;
+    uint32_t max_latency;   /* cycles from the first raise to the run */
+    uint32_t max_cycles;    /* longest run */
+    uint64_t cycles;        /* total run time */
+} softirq_stat_t;
+
+void softirq_get_stat(uint8_t nr, softirq_stat_t *out);
+uint32_t softirq_deferred(void);    /* runs that left work after the last pass */
+void softirq_reset_stats(void);
+
+#endif
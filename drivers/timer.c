@@ -0,0 +1,67 @@
+#include "timer.h"
+#include "isr.h"
+#include "io.h"
+#include "framebuffer.h"
+#include "replay.h"
+#include "softirq.h"
+
+/* PIT ports and input clock */
+#define PIT_CHANNEL0  0x40
+#define PIT_COMMAND   0x43
+#define PIT_BASE_HZ   1193182
+
+/* Command byte: channel 0, lobyte/hibyte access, mode 3 (square wave), binary */
+#define PIT_CMD_CH0_RATE 0x36
+
+static volatile uint32_t ticks = 0;
+static uint32_t tick_hz = 0;
+static timer_hook_t tick_hook = 0;
+
+/* Timer interrupt handler (IRQ0): count the tick, leave the rest to the
+ * softirq
+ */
+static void timer_callback(registers_t *regs) {
+    (void)regs;  // Unused parameter
+
+    ticks++;
+    softirq_raise(SOFTIRQ_TIMER);
+}
+
+/* Timer softirq: run the tick hook, feed scripted keystrokes and push
+ * pending console output. Ticks that arrive while it is held off are
+ * folded into one run.
+ */
+static void timer_softirq(void) {
+    uint32_t now = ticks;
+
+    if (tick_hook)
+        tick_hook(now);
+    replay_tick(now);
+    fb_tick();
+}
+
+/* Program PIT channel 0 to fire IRQ0 `hz` times per second */
+void init_timer(uint32_t hz) {
+    if (hz == 0) hz = TIMER_DEFAULT_HZ;
+    tick_hz = hz;
+
+    register_softirq(SOFTIRQ_TIMER, "timer", timer_softirq);
+    register_interrupt_handler(IRQ0, timer_callback);
+
+    uint32_t divisor = PIT_BASE_HZ / hz;
+    if (divisor > 0xFFFF) divisor = 0xFFFF;
+
+    outb(PIT_COMMAND, PIT_CMD_CH0_RATE);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+
+    /* Unmask IRQ0 (Timer) on the PIC or I/O APIC */
+    irq_unmask(0);
+}
+
+void timer_set_hook(timer_hook_t hook) {
+    tick_hook = hook;
+}
+
+uint32_t timer_get_ticks(void) { return ticks; }
+uint32_t timer_get_hz(void) { return tick_hz; }
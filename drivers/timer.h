@@ -0,0 +1,18 @@
+#ifndef INCLUDE_TIMER_H
+#define INCLUDE_TIMER_H
+
+#include "types.h"
+
+// Programmable Interval Timer (8253/8254) channel 0 on IRQ0.
+#define TIMER_DEFAULT_HZ 100
+
+// Optional function run from the timer softirq, before the console flush.
+// Runs once per tick unless softirqs were held off for more than a tick.
+typedef void (*timer_hook_t)(uint32_t ticks);
+
+void init_timer(uint32_t hz);
+void timer_set_hook(timer_hook_t hook);
+uint32_t timer_get_ticks(void);
+uint32_t timer_get_hz(void);
+
+#endif
@@ -0,0 +1,84 @@
+#include "trace.h"
+#include "tsc.h"
+#include "timer.h"
+#include "kprintf.h"
+#include "irqflags.h"
+
+volatile uint8_t trace_enabled = 0;
+
+static trace_event_t ring[TRACE_EVENTS_MAX];
+static uint32_t head = 0;   /* events recorded since the last clear */
+
+/* TSC and timer tick when tracing first started; the dump pairs them with
+ * the current values so the host can work out the TSC frequency.
+ */
+static uint64_t ref_tsc = 0;
+static uint32_t ref_tick = 0;
+
+void trace_record(uint16_t id, uint8_t phase, uint32_t arg) {
+    uint32_t flags = irq_save();
+    trace_event_t *e = &ring[head % TRACE_EVENTS_MAX];
+    head++;
+    e->tsc = rdtsc();
+    e->id = id;
+    e->phase = phase;
+    e->reserved = 0;
+    e->arg = arg;
+    irq_restore(flags);
+}
+
+void trace_start(void) {
+    if (ref_tsc == 0) {
+        ref_tick = timer_get_ticks();
+        ref_tsc = rdtsc();
+    }
+    trace_enabled = 1;
+}
+
+void trace_stop(void) {
+    trace_enabled = 0;
+}
+
+void trace_clear(void) {
+    uint32_t flags = irq_save();
+    head = 0;
+    irq_restore(flags);
+}
+
+uint32_t trace_count(void) {
+    return (head < TRACE_EVENTS_MAX) ? head : TRACE_EVENTS_MAX;
+}
+
+uint32_t trace_lost(void) {
+    return head - trace_count();
+}
+
+void trace_dump(trace_write_t out) {
+    static const char hex[] = "0123456789abcdef";
+    char line[sizeof(trace_event_t) * 2 + 1];
+    char hdr[160];
+    uint8_t was_enabled = trace_enabled;
+
+    trace_enabled = 0;
+
+    uint32_t count = trace_count();
+    uint32_t first = head - count;
+    int n = k_snprintf(hdr, sizeof(hdr),
+                       TRACE_DUMP_MAGIC " events=%u lost=%u hz=%u tsc0=%llx tick0=%u tsc1=%llx tick1=%u\n",
+                       count, trace_lost(), timer_get_hz(),
+                       ref_tsc, ref_tick, rdtsc(), timer_get_ticks());
+    out(hdr, (uint32_t)n);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *b = (const uint8_t *)&ring[(first + i) % TRACE_EVENTS_MAX];
+        for (uint32_t j = 0; j < sizeof(trace_event_t); j++) {
+            line[2 * j] = hex[b[j] >> 4];
+            line[2 * j + 1] = hex[b[j] & 0x0F];
+        }
+        line[sizeof(line) - 1] = '\n';
+        out(line, sizeof(line));
+    }
+
+    out(TRACE_DUMP_END "\n", sizeof(TRACE_DUMP_END "\n") - 1);
+    trace_enabled = was_enabled;
+}
@@ -0,0 +1,60 @@
+#ifndef INCLUDE_TRACE_H
+#define INCLUDE_TRACE_H
+
+#include "types.h"
+#include "trace_events.h"
+
+// Static tracepoints: TRACE_BEGIN/END/INSTANT record a 16-byte event with
+// a TSC timestamp into a ring of TRACE_EVENTS_MAX (newest kept). While
+// tracing is off a tracepoint is one load and a not-taken branch.
+#define TRACE_EVENTS_MAX 4096
+
+#define TRACE_ENUM(id, name, arg) id,
+enum { TRACE_EVENTS(TRACE_ENUM) TRACE_NUM_IDS };
+#undef TRACE_ENUM
+
+typedef struct {
+    uint64_t tsc;
+    uint16_t id;
+    uint8_t  phase;
+    uint8_t  reserved;
+    uint32_t arg;
+} trace_event_t;
+
+extern volatile uint8_t trace_enabled;
+
+void trace_record(uint16_t id, uint8_t phase, uint32_t arg);
+
+#define TRACE(id, phase, arg)                                         \
+    do {                                                              \
+        if (__builtin_expect(trace_enabled, 0))                      \
+            trace_record((id), (phase), (uint32_t)(arg));             \
+    } while (0)
+
+#define TRACE_BEGIN(id, arg)    TRACE(id, TRACE_PH_BEGIN, arg)
+#define TRACE_END(id, arg)      TRACE(id, TRACE_PH_END, arg)
+#define TRACE_INSTANT(id, arg)  TRACE(id, TRACE_PH_INSTANT, arg)
+
+// Up to 4 bytes of a command name packed into an event argument
+static inline uint32_t trace_tag(const char *s) {
+    uint32_t tag = 0;
+    for (int i = 0; i < 4 && s[i] != '\0' && s[i] != ' '; i++)
+        tag |= (uint32_t)(uint8_t)s[i] << (8 * i);
+    return tag;
+}
+
+// Control (main context)
+// - trace_start()/trace_stop(): turn the tracepoints on or off
+// - trace_clear(): drop recorded events
+// - trace_dump(out): write the ring, oldest first, in the text framing
+//   of trace_events.h (tracing is paused meanwhile)
+typedef void (*trace_write_t)(const char *s, uint32_t len);
+
+void trace_start(void);
+void trace_stop(void);
+void trace_clear(void);
+uint32_t trace_count(void);
+uint32_t trace_lost(void);
+void trace_dump(trace_write_t out);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef INCLUDE_TRACE_EVENTS_H
+#define INCLUDE_TRACE_EVENTS_H
+
+// Tracepoint IDs and names, shared by the kernel (trace.h) and the host
+// converter (tools/trace2json.c). Dumps store the ID, so only append.
+//   X(id, name, meaning of the event argument)
+#define TRACE_EVENTS(X)                                          \
+    X(TRACE_IRQ,      "irq",      "IRQ line")                    \
+    X(TRACE_DISPATCH, "dispatch", "interrupt vector")            \
+    X(TRACE_KBD_WAKE, "kbd_wake", "1 if input was waiting")      \
+    X(TRACE_FB_FLUSH, "fb_flush", "cells copied")                \
+    X(TRACE_CMD,      "cmd",      "first 4 bytes of the command")
+
+// Event phases, as in the Chrome trace format
+#define TRACE_PH_BEGIN    'B'
+#define TRACE_PH_END      'E'
+#define TRACE_PH_INSTANT  'i'
+
+// Dump framing: a header line, one line of 32 hex digits per event (the
+// 16-byte trace_event_t, little-endian), then the end line.
+//   #TRACE v1 events=N lost=N hz=N tsc0=X tick0=N tsc1=X tick1=N
+#define TRACE_DUMP_MAGIC  "#TRACE v1"
+#define TRACE_DUMP_END    "#TRACE end"
+
+#endif
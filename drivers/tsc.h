@@ -0,0 +1,13 @@
+#ifndef INCLUDE_TSC_H
+#define INCLUDE_TSC_H
+
+#include "types.h"
+
+// Read the CPU time-stamp counter (cycles since reset).
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif
@@ -10,6 +10,8 @@ typedef unsigned char  u8int;
 typedef char           s8int;
 
 // C99-style integer types
+typedef unsigned long long uint64_t;
+typedef long long      int64_t;
 typedef unsigned int   uint32_t;
 typedef int            int32_t;
 typedef unsigned short uint16_t;
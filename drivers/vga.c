@@ -0,0 +1,251 @@
+#include "vga.h"
+#include "io.h"
+#include "font8x8.h"
+
+/* VGA register ports */
+#define VGA_AC_INDEX      0x3C0
+#define VGA_AC_WRITE      0x3C0
+#define VGA_MISC_WRITE    0x3C2
+#define VGA_SEQ_INDEX     0x3C4
+#define VGA_SEQ_DATA      0x3C5
+#define VGA_GC_INDEX      0x3CE
+#define VGA_GC_DATA       0x3CF
+#define VGA_CRTC_INDEX    0x3D4
+#define VGA_CRTC_DATA     0x3D5
+#define VGA_INSTAT_READ   0x3DA
+
+#define VGA_NUM_SEQ_REGS  5
+#define VGA_NUM_CRTC_REGS 25
+#define VGA_NUM_GC_REGS   9
+#define VGA_NUM_AC_REGS   21
+#define VGA_NUM_REGS      (1 + VGA_NUM_SEQ_REGS + VGA_NUM_CRTC_REGS + VGA_NUM_GC_REGS + VGA_NUM_AC_REGS)
+
+/* With odd/even addressing off, plane 2 (the font plane) appears at the
+ * text-mode memory window; each glyph slot is 32 bytes.
+ */
+#define VGA_FONT_WINDOW   ((volatile uint8_t *)0x000B8000)
+#define VGA_GLYPH_SLOT    32
+
+static const vga_mode_info_t mode_info[VGA_MODE_COUNT] = {
+    { 80, 25, 16 },
+    { 80, 50, 8 },
+    { 90, 60, 8 },
+};
+
+/* Register dumps in the order MISC, SEQ[0..4], CRTC[0..24], GC[0..8],
+ * AC[0..20]. The 8-line modes reuse the 80x25 timings with half-height
+ * cells (80x50) or switch to the 28 MHz clock, 8-dot characters and 480
+ * scan lines (90x60).
+ */
+static const uint8_t mode_regs[VGA_MODE_COUNT][VGA_NUM_REGS] = {
+    {   /* 80x25 */
+        0x67,
+        0x03, 0x00, 0x03, 0x00, 0x02,
+        0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F,
+        0x00, 0x4F, 0x0D, 0x0E, 0x00, 0x00, 0x00, 0x00,
+        0x9C, 0x0E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+        0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+        0x0C, 0x00, 0x0F, 0x08, 0x00
+    },
+    {   /* 80x50 */
+        0x67,
+        0x03, 0x00, 0x03, 0x00, 0x02,
+        0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F,
+        0x00, 0x47, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00,
+        0x9C, 0x8E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+        0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+        0x0C, 0x00, 0x0F, 0x08, 0x00
+    },
+    {   /* 90x60 */
+        0xE7,
+        0x03, 0x01, 0x03, 0x00, 0x02,
+        0x6B, 0x59, 0x5A, 0x82, 0x60, 0x8D, 0x0B, 0x3E,
+        0x00, 0x47, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00,
+        0xEA, 0x0C, 0xDF, 0x2D, 0x08, 0xE8, 0x05, 0xA3, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+        0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+        0x0C, 0x00, 0x0F, 0x08, 0x00
+    },
+};
+
+static vga_text_mode_t current_mode = VGA_MODE_80X25;
+
+/* BIOS 8x16 font read back from plane 2, and the 8x8 font built from it. */
+static uint8_t bios_font[256 * 16];
+static uint8_t bios_font_saved = 0;
+static uint8_t font8[256 * 8];
+static uint8_t font8_built = 0;
+
+const vga_mode_info_t *vga_mode_info(vga_text_mode_t mode) {
+    if (mode >= VGA_MODE_COUNT)
+        return 0;
+    return &mode_info[mode];
+}
+
+static void write_regs(const uint8_t *regs) {
+    outb(VGA_MISC_WRITE, *regs++);
+
+    for (uint8_t i = 0; i < VGA_NUM_SEQ_REGS; i++) {
+        outb(VGA_SEQ_INDEX, i);
+        outb(VGA_SEQ_DATA, *regs++);
+    }
+
+    /* Unlock CRTC registers 0-7 (and keep them unlocked below) */
+    outb(VGA_CRTC_INDEX, 0x03);
+    outb(VGA_CRTC_DATA, inb(VGA_CRTC_DATA) | 0x80);
+    outb(VGA_CRTC_INDEX, 0x11);
+    outb(VGA_CRTC_DATA, inb(VGA_CRTC_DATA) & ~0x80);
+
+    for (uint8_t i = 0; i < VGA_NUM_CRTC_REGS; i++) {
+        uint8_t v = *regs++;
+        if (i == 0x03) v |= 0x80;
+        if (i == 0x11) v &= ~0x80;
+        outb(VGA_CRTC_INDEX, i);
+        outb(VGA_CRTC_DATA, v);
+    }
+
+    for (uint8_t i = 0; i < VGA_NUM_GC_REGS; i++) {
+        outb(VGA_GC_INDEX, i);
+        outb(VGA_GC_DATA, *regs++);
+    }
+
+    /* Reading input status #1 resets the attribute controller flip-flop */
+    for (uint8_t i = 0; i < VGA_NUM_AC_REGS; i++) {
+        (void)inb(VGA_INSTAT_READ);
+        outb(VGA_AC_INDEX, i);
+        outb(VGA_AC_WRITE, *regs++);
+    }
+
+    /* Lock the palette and unblank the display */
+    (void)inb(VGA_INSTAT_READ);
+    outb(VGA_AC_INDEX, 0x20);
+}
+
+/* Saved sequencer/graphics state while plane 2 is mapped for font access */
+typedef struct {
+    uint8_t seq2, seq4, gc4, gc5, gc6;
+} plane_state_t;
+
+static uint8_t read_reg(uint16_t index_port, uint8_t index) {
+    outb(index_port, index);
+    return inb(index_port + 1);
+}
+
+static void write_reg(uint16_t index_port, uint8_t index, uint8_t value) {
+    outb(index_port, index);
+    outb(index_port + 1, value);
+}
+
+/* Map plane 2 flat at the text window: odd/even addressing off, reads and
+ * writes both directed at plane 2.
+ */
+static void font_plane_begin(plane_state_t *s) {
+    s->seq2 = read_reg(VGA_SEQ_INDEX, 2);
+    s->seq4 = read_reg(VGA_SEQ_INDEX, 4);
+    s->gc4 = read_reg(VGA_GC_INDEX, 4);
+    s->gc5 = read_reg(VGA_GC_INDEX, 5);
+    s->gc6 = read_reg(VGA_GC_INDEX, 6);
+
+    write_reg(VGA_SEQ_INDEX, 4, s->seq4 | 0x04);
+    write_reg(VGA_GC_INDEX, 5, s->gc5 & ~0x10);
+    write_reg(VGA_GC_INDEX, 6, s->gc6 & ~0x02);
+    write_reg(VGA_GC_INDEX, 4, 2);
+    write_reg(VGA_SEQ_INDEX, 2, 1 << 2);
+}
+
+static void font_plane_end(const plane_state_t *s) {
+    write_reg(VGA_SEQ_INDEX, 2, s->seq2);
+    write_reg(VGA_SEQ_INDEX, 4, s->seq4);
+    write_reg(VGA_GC_INDEX, 4, s->gc4);
+    write_reg(VGA_GC_INDEX, 5, s->gc5);
+    write_reg(VGA_GC_INDEX, 6, s->gc6);
+}
+
+static void save_bios_font(void) {
+    plane_state_t s;
+
+    font_plane_begin(&s);
+    for (uint32_t ch = 0; ch < 256; ch++)
+        for (uint32_t line = 0; line < 16; line++)
+            bios_font[ch * 16 + line] = VGA_FONT_WINDOW[ch * VGA_GLYPH_SLOT + line];
+    font_plane_end(&s);
+
+    bios_font_saved = 1;
+}
+
+static void load_font(const uint8_t *glyphs, uint8_t height) {
+    plane_state_t s;
+
+    font_plane_begin(&s);
+    for (uint32_t ch = 0; ch < 256; ch++)
+        for (uint32_t line = 0; line < VGA_GLYPH_SLOT; line++)
+            VGA_FONT_WINDOW[ch * VGA_GLYPH_SLOT + line] =
+                (line < height) ? glyphs[ch * height + line] : 0;
+    font_plane_end(&s);
+}
+
+static uint8_t reverse_bits(uint8_t b) {
+    b = (uint8_t)(((b & 0xF0) >> 4) | ((b & 0x0F) << 4));
+    b = (uint8_t)(((b & 0xCC) >> 2) | ((b & 0x33) << 2));
+    b = (uint8_t)(((b & 0xAA) >> 1) | ((b & 0x55) << 1));
+    return b;
+}
+
+/* 8x8 font: font8x8_ascii for ASCII (VGA wants bit 7 leftmost), everything
+ * else squeezed from the BIOS font by OR-ing pairs of scan lines, which
+ * keeps the box-drawing characters joined up.
+ */
+static void build_font8(void) {
+    for (uint32_t ch = 0; ch < 256; ch++) {
+        for (uint32_t line = 0; line < 8; line++) {
+            uint8_t bits;
+            if (ch >= FONT8X8_FIRST && ch < FONT8X8_FIRST + FONT8X8_GLYPHS)
+                bits = reverse_bits(font8x8_ascii[ch - FONT8X8_FIRST][line]);
+            else if (bios_font_saved)
+                bits = bios_font[ch * 16 + 2 * line] | bios_font[ch * 16 + 2 * line + 1];
+            else
+                bits = 0;
+            font8[ch * 8 + line] = bits;
+        }
+    }
+    font8_built = 1;
+}
+
+/* The line compare value is 10 bits: bits 0-7 in CRTC 0x18, bit 8 in the
+ * overflow register (0x07 bit 4), bit 9 in the maximum scan line register
+ * (0x09 bit 6). 0x07 is write-protected until 0x11 bit 7 is cleared.
+ */
+void vga_set_line_compare(uint16_t line) {
+    write_reg(VGA_CRTC_INDEX, 0x11, read_reg(VGA_CRTC_INDEX, 0x11) & ~0x80);
+
+    write_reg(VGA_CRTC_INDEX, 0x18, line & 0xFF);
+    write_reg(VGA_CRTC_INDEX, 0x07,
+              (read_reg(VGA_CRTC_INDEX, 0x07) & ~0x10) | ((line >> 4) & 0x10));
+    write_reg(VGA_CRTC_INDEX, 0x09,
+              (read_reg(VGA_CRTC_INDEX, 0x09) & ~0x40) | ((line >> 3) & 0x40));
+}
+
+void vga_set_text_mode(vga_text_mode_t mode) {
+    if (mode >= VGA_MODE_COUNT)
+        return;
+
+    if (current_mode == VGA_MODE_80X25 && !bios_font_saved)
+        save_bios_font();
+
+    write_regs(mode_regs[mode]);
+
+    if (mode_info[mode].char_height == 8) {
+        if (!font8_built)
+            build_font8();
+        load_font(font8, 8);
+    } else if (bios_font_saved) {
+        load_font(bios_font, 16);
+    }
+
+    current_mode = mode;
+}
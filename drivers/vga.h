@@ -0,0 +1,32 @@
+#ifndef INCLUDE_VGA_H
+#define INCLUDE_VGA_H
+
+#include "types.h"
+
+// VGA text modes that can be programmed at runtime (no BIOS calls).
+typedef enum {
+    VGA_MODE_80X25 = 0,   // 9x16 cells, the BIOS boot mode
+    VGA_MODE_80X50,       // 8x8 cells, 400 scan lines
+    VGA_MODE_90X60,       // 8x8 cells, 480 scan lines
+    VGA_MODE_COUNT
+} vga_text_mode_t;
+
+typedef struct {
+    uint16_t cols;
+    uint16_t rows;
+    uint8_t char_height;
+} vga_mode_info_t;
+
+const vga_mode_info_t *vga_mode_info(vga_text_mode_t mode);
+
+// Program the sequencer/CRTC/graphics/attribute registers for `mode` and
+// load a matching font into plane 2. The BIOS 8x16 font is saved the first
+// time the driver leaves 80x25, so the boot mode can be restored exactly.
+void vga_set_text_mode(vga_text_mode_t mode);
+
+// Split screen: after scan line `line` the CRTC restarts display at VGA
+// address 0, whatever the start address. 0x3FF (the mode default) turns
+// the split off.
+void vga_set_line_compare(uint16_t line);
+
+#endif
@@ -1,6 +1,7 @@
 #include "framebuffer.h"
-#include "keyboard.h"
+#include "lineedit.h"
 #include "menu.h"
+#include "kprintf.h"
 
 // Tiny string helpers (no libc)
 static int k_strcmp(const char *s1, const char *s2) {
@@ -28,32 +29,41 @@ static void calc_print_menu(uint8_t primary_color) {
     write_str("Commands:\n");
 
     // Command names in primary_color, descriptions in white.
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  help"); set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("      -> show this menu\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  add");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> a + b\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  sub");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> a - b\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  mul");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> a * b\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  div");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> a / b\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  mod");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> a % b\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  pow");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> a^b (b >= 0)\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  min");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> min(a,b)\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  max");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("  a b   -> max(a,b)\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  mean"); set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str(" a b   -> (a+b)/2 (integer)\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  quit"); set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("      -> return to OS\n");
+    char c = KC(primary_color);
+    k_printf(KCOLOR "  help" KCOLOR_RESET "      -> show this menu\n", c);
+    k_printf(KCOLOR "  add"  KCOLOR_RESET "  a b   -> a + b\n", c);
+    k_printf(KCOLOR "  sub"  KCOLOR_RESET "  a b   -> a - b\n", c);
+    k_printf(KCOLOR "  mul"  KCOLOR_RESET "  a b   -> a * b\n", c);
+    k_printf(KCOLOR "  div"  KCOLOR_RESET "  a b   -> a / b\n", c);
+    k_printf(KCOLOR "  mod"  KCOLOR_RESET "  a b   -> a %% b\n", c);
+    k_printf(KCOLOR "  pow"  KCOLOR_RESET "  a b   -> a^b (b >= 0)\n", c);
+    k_printf(KCOLOR "  min"  KCOLOR_RESET "  a b   -> min(a,b)\n", c);
+    k_printf(KCOLOR "  max"  KCOLOR_RESET "  a b   -> max(a,b)\n", c);
+    k_printf(KCOLOR "  mean" KCOLOR_RESET " a b   -> (a+b)/2 (integer)\n", c);
+    k_printf(KCOLOR "  quit" KCOLOR_RESET "      -> return to OS\n", c);
 }
 
+// Prompt state (history, Tab completion) kept across calc sessions
+static le_prompt_t calc_prompt;
+
+static const char *const calc_commands[] = {
+    "help", "add", "sub", "mul", "div", "mod", "pow", "min", "max", "mean", "quit"
+};
+
 void calculator_mode(uint8_t primary_color) {
     char buf[128];
 
+    if (calc_prompt.commands.used == 0)
+        for (unsigned i = 0; i < sizeof(calc_commands) / sizeof(calc_commands[0]); i++)
+            le_add_command(&calc_prompt, calc_commands[i]);
+
     // Print the calculator menu once when entering calculator mode.
     calc_print_menu(primary_color);
 
     for (;;) {
+        // Prompt and user input in primary_color (calculator "command" color).
         set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        write_str("calc> ");
-
-        // User input should appear in primary_color (calculator "command" color).
-        set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        kbd_readline(buf, sizeof(buf));
+        le_readline(&calc_prompt, "calc> ", buf, sizeof(buf));
 
         set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
 
@@ -77,34 +87,34 @@ void calculator_mode(uint8_t primary_color) {
 
         if (k_match_cmd(buf, "add", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: add <a> <b>\n");
-            else { write_dec(a + b); put_char('\n'); }
+            else k_printf("%d\n", a + b);
         } else if (k_match_cmd(buf, "sub", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: sub <a> <b>\n");
-            else { write_dec(a - b); put_char('\n'); }
+            else k_printf("%d\n", a - b);
         } else if (k_match_cmd(buf, "mul", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: mul <a> <b>\n");
-            else { write_dec(a * b); put_char('\n'); }
+            else k_printf("%d\n", a * b);
         } else if (k_match_cmd(buf, "div", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: div <a> <b>\n");
             else if (b == 0) write_str("Error: divide by zero\n");
-            else { write_dec(a / b); put_char('\n'); }
+            else k_printf("%d\n", a / b);
         } else if (k_match_cmd(buf, "mod", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: mod <a> <b>\n");
             else if (b == 0) write_str("Error: divide by zero\n");
-            else { write_dec(a % b); put_char('\n'); }
+            else k_printf("%d\n", a % b);
         } else if (k_match_cmd(buf, "pow", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: pow <base> <exp>\n");
             else if (b < 0) write_str("Error: exp must be >= 0\n");
-            else { write_dec(ipow(a, b)); put_char('\n'); }
+            else k_printf("%d\n", ipow(a, b));
         } else if (k_match_cmd(buf, "min", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: min <a> <b>\n");
-            else { write_dec((a < b) ? a : b); put_char('\n'); }
+            else k_printf("%d\n", (a < b) ? a : b);
         } else if (k_match_cmd(buf, "max", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: max <a> <b>\n");
-            else { write_dec((a > b) ? a : b); put_char('\n'); }
+            else k_printf("%d\n", (a > b) ? a : b);
         } else if (k_match_cmd(buf, "mean", &args)) {
             if (!k_parse_two_ints(args, &a, &b)) write_str("Usage: mean <a> <b>\n");
-            else { write_dec((a + b) / 2); put_char('\n'); }
+            else k_printf("%d\n", (a + b) / 2);
         } else {
             write_str("Unknown calculator command (type 'quit' to exit)\n");
         }
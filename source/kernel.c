@@ -3,7 +3,21 @@
 #include "isr.h"
 #include "io.h"
 #include "keyboard.h"
+#include "lineedit.h"
+#include "serial.h"
+#include "mouse.h"
+#include "replay.h"
+#include "inputlat.h"
+#include "softirq.h"
+#include "timer.h"
+#include "tsc.h"
+#include "kprintf.h"
+#include "klog.h"
+#include "trace.h"
+#include "multiboot.h"
+#include "lfb.h"
 #include "menu.h"
+#include "status.h"
 #include "version.h"
 
 // Helper function to compare two strings
@@ -28,6 +42,19 @@ int strncmp(const char *s1, const char *s2, int n) {
     return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
 
+// Non-zero if the space-separated boot command line contains `name`
+static int boot_option(const char *cmdline, const char *name) {
+    int n = 0;
+    while (name[n])
+        n++;
+    for (const char *p = cmdline; *p; p++) {
+        if ((p == cmdline || p[-1] == ' ') && strncmp(p, name, n) == 0 &&
+            (p[n] == '\0' || p[n] == ' '))
+            return 1;
+    }
+    return 0;
+}
+
 static void print_os_version(void) {
     // Versioning policy: v<hundreds>.<tens>.<ones>, derived from git commit count at build time.
     // Example: 41 commits => v0.4.1, 137 commits => v1.3.7
@@ -104,9 +131,551 @@ static void vga_test(void) {
     set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
 }
 
+static void print_fb_stats(void) {
+    // Snapshot first so printing the report does not skew the numbers.
+    fb_stats_t st;
+    fb_get_stats(&st);
+
+    write_str("flushes:       "); write_dec((int)st.flushes); put_char('\n');
+    write_str("cells flushed: "); write_dec((int)st.cells_flushed); put_char('\n');
+    write_str("cursor syncs:  "); write_dec((int)st.cursor_syncs); put_char('\n');
+    write_str("hw scrolls:    "); write_dec((int)st.hw_scrolls); put_char('\n');
+    write_str("ring wraps:    "); write_dec((int)st.ring_wraps); put_char('\n');
+    write_str("kbd dropped:   "); write_dec((int)kbd_dropped()); put_char('\n');
+}
+
+static void print_mouse_stats(void) {
+    mouse_stats_t st;
+    mouse_get_stats(&st);
+
+    if (!mouse_present()) {
+        write_str("No PS/2 mouse.\n");
+        return;
+    }
+    k_printf("packets:    %u (resyncs %u)\n", st.packets, st.resyncs);
+    k_printf("moves:      %u (coalesced %u)\n", st.moves, st.coalesced);
+    k_printf("polls:      %u\n", st.polls);
+    k_printf("dropped:    %u button events\n", st.dropped);
+    k_printf("selection:  \"%s\"\n", mouse_clipboard());
+}
+
+static void print_serial_stats(void) {
+    serial_stats_t st;
+    serial_get_stats(&st);
+
+    k_printf("rx bytes:   %u (dropped %u)\n", st.rx_bytes, st.rx_dropped);
+    k_printf("tx bytes:   %u (dropped %u)\n", st.tx_bytes, st.tx_dropped);
+    k_printf("tx bursts:  %u\n", st.tx_bursts);
+}
+
+// Cycle cost of the two heaviest framebuffer operations: a full-screen
+// clear and a one-line scroll, each including the flush to VGA memory.
+static void fb_bench(void) {
+    const int rounds = 32;
+    uint64_t t0, clear_cycles, scroll_cycles;
+
+    t0 = rdtsc();
+    for (int i = 0; i < rounds; i++) {
+        clear_screen();
+        fb_flush();
+    }
+    clear_cycles = rdtsc() - t0;
+
+    move_cursor(0, fb_height() - 1);
+    t0 = rdtsc();
+    for (int i = 0; i < rounds; i++) {
+        put_char('\n');
+        fb_flush();
+    }
+    scroll_cycles = rdtsc() - t0;
+
+    clear_screen();
+    write_str("clear + flush:  "); write_dec_ll((long long)(clear_cycles / rounds)); write_str(" cycles\n");
+    write_str("scroll + flush: "); write_dec_ll((long long)(scroll_cycles / rounds)); write_str(" cycles\n");
+}
+
+// Software-interrupt round trips through a bare iret, the IRQ entry, and
+// (IRQBENCH_OLD=1 builds) the entry it replaced.
+static void irq_bench_command(void) {
+    irq_bench_t b;
+    irq_bench(10000, &b);
+
+    k_printf("int + iret:          %5u cycles\n", b.bare);
+    k_printf("IRQ entry:           %5u cycles\n", b.lean);
+    if (b.full == 0) {
+        k_printf("(build with IRQBENCH_OLD=1 to compare the old entry)\n");
+        return;
+    }
+    k_printf("IRQ entry (old):     %5u cycles\n", b.full);
+    if (b.full > b.lean)
+        k_printf("saved per interrupt: %5u cycles\n", b.full - b.lean);
+}
+
+// Search the scrollback (and the screen above the prompt) for `needle`,
+// newest match first. Matches are collected before printing because the
+// report itself scrolls lines into the history.
+#define FIND_MAX_MATCHES 16
+static char find_text[FIND_MAX_MATCHES][FB_MAX_WIDTH + 1];
+static uint32_t find_back[FIND_MAX_MATCHES];
+
+static void find_in_history(const char *needle) {
+    uint32_t back = 1, hit;
+    int shown = 0, total = 0;
+
+    while (fb_history_find(needle, back, &hit)) {
+        if (shown < FIND_MAX_MATCHES) {
+            find_back[shown] = hit;
+            fb_history_text(hit, find_text[shown], sizeof(find_text[shown]));
+            shown++;
+        }
+        total++;
+        back = hit + 1;
+    }
+
+    for (int i = shown - 1; i >= 0; i--) {
+        set_color(FRAMEBUFFER_COLOR_DARK_GREY, FRAMEBUFFER_COLOR_BLACK);
+        write_str("-");
+        write_dec((int)find_back[i]);
+        write_str(": ");
+        set_color(FRAMEBUFFER_COLOR_LIGHT_GREY, FRAMEBUFFER_COLOR_BLACK);
+        write_str(find_text[i]);
+        put_char('\n');
+    }
+
+    write_dec(total);
+    write_str(total == 1 ? " match" : " matches");
+    if (total > shown) {
+        write_str(" (showing newest ");
+        write_dec(shown);
+        write_str(")");
+    }
+    write_str(" - Shift+PgUp/PgDn to scroll\n");
+}
+
+// `mode` lists the text modes; `mode <cols>x<rows>` switches to one.
+static void text_mode_command(const char *arg) {
+    int cols, rows;
+    const char *p;
+
+    arg = k_skip_ws(arg);
+    if (arg[0] == '\0') {
+        k_printf("Current mode: %ux%u\nAvailable: 80x25 80x50 90x60\n", fb_width(), fb_height());
+        return;
+    }
+
+    if (!k_parse_int(arg, &cols, &p) || (*p != 'x' && *p != 'X') ||
+        !k_parse_int(p + 1, &rows, &p) || *k_skip_ws(p) != '\0' ||
+        cols <= 0 || rows <= 0 || fb_set_mode((uint16_t)cols, (uint16_t)rows) != 0) {
+        write_str("Usage: mode [80x25|80x50|90x60]\n");
+        return;
+    }
+
+    klog(KLOG_INFO, "fb: text mode %dx%d", cols, rows);
+    k_printf("Text mode %dx%d\n", cols, rows);
+}
+
+// Kernel log sink for the screen. The serial mirror is suspended while it
+// writes: the serial line has a klog sink (and level) of its own.
+static void klog_console_write(const char *s, uint32_t len) {
+    fb_mirror_t mirror = fb_set_mirror(0);
+    fb_write_buf(s, len);
+    fb_set_mirror(mirror);
+}
+
+// Log level by number (0-3) or name (err, warn, info, debug).
+static int parse_log_level(const char *s, int *level) {
+    const char *end;
+
+    s = k_skip_ws(s);
+    if (k_parse_int(s, level, &end) && *k_skip_ws(end) == '\0')
+        return *level >= KLOG_ERR && *level <= KLOG_DEBUG;
+
+    for (int i = KLOG_ERR; i <= KLOG_DEBUG; i++) {
+        if (k_match_cmd(s, klog_level_name((uint8_t)i), &end) && *k_skip_ws(end) == '\0') {
+            *level = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// `dmesg [level]` replays the log records still in the ring, optionally
+// only those at `level` or more severe. `dmesg -n <level>` sets which
+// records are printed on the console as they are logged.
+static void dmesg_command(const char *arg) {
+    static klog_record_t rec;
+    static char line[KLOG_MSG_MAX + 32];
+    int level = KLOG_DEBUG;
+
+    arg = k_skip_ws(arg);
+    if (arg[0] == '-' && arg[1] == 'n') {
+        if (!parse_log_level(arg + 2, &level)) {
+            write_str("Usage: dmesg -n <0-3|err|warn|info|debug>\n");
+            return;
+        }
+        klog_set_level(KLOG_SINK_CONSOLE, (uint8_t)level);
+        k_printf("Console log level: %s\n", klog_level_name((uint8_t)level));
+        return;
+    }
+    if (arg[0] != '\0' && !parse_log_level(arg, &level)) {
+        write_str("Usage: dmesg [level] | dmesg -n <level>\n");
+        return;
+    }
+
+    for (uint32_t seq = klog_first_seq(); seq != klog_next_seq(); seq++) {
+        if (klog_read(seq, &rec) != 0 || rec.level > (uint8_t)level)
+            continue;
+        int n = klog_format(&rec, line, sizeof(line));
+        fb_write_buf(line, (uint32_t)n);
+    }
+}
+
+// `trace on|off|clear|dump`; no argument prints the state. The dump goes
+// to COM1 only (see tools/trace2json.c for turning it into a trace file).
+static void trace_command(const char *arg) {
+    arg = k_skip_ws(arg);
+
+    if (strcmp(arg, "on") == 0) {
+        trace_start();
+    } else if (strcmp(arg, "off") == 0) {
+        trace_stop();
+    } else if (strcmp(arg, "clear") == 0) {
+        trace_clear();
+    } else if (strcmp(arg, "dump") == 0) {
+        if (!serial_present()) {
+            write_str("trace dump: no serial port\n");
+            return;
+        }
+        k_printf("Dumping %u events to COM1...\n", trace_count());
+        trace_dump(serial_console_write);
+    } else if (arg[0] != '\0') {
+        write_str("Usage: trace [on|off|clear|dump]\n");
+        return;
+    }
+
+    k_printf("Tracing %s, %u events recorded (%u overwritten)\n",
+             trace_enabled ? "on" : "off", trace_count(), trace_lost());
+}
+
+// `replay [status]` shows playback and recording; `replay load` reads a
+// key script typed or sent over the serial line up to Ctrl+D and plays
+// it; `replay record` / `replay stop` capture the session, `replay play`
+// plays the capture and `replay dump` sends it to COM1.
+static char replay_script[REPLAY_RECORD_MAX];
+
+static void replay_command(const char *arg) {
+    replay_status_t st;
+    uint32_t len;
+    const char *text;
+
+    arg = k_skip_ws(arg);
+
+    if (strcmp(arg, "load") == 0) {
+        replay_stop();
+        write_str("Send the key script, then Ctrl+D (Ctrl+C cancels).\n");
+        len = 0;
+        for (;;) {
+            int k = kbd_getkey();
+            if (k == 0x04)
+                break;
+            if (k == 0x03) {
+                kbd_echo_skip();
+                write_str("Cancelled.\n");
+                return;
+            }
+            if (k < 0x100 && len < sizeof(replay_script))
+                replay_script[len++] = (char)k;
+        }
+        kbd_echo_skip();
+        replay_start(replay_script, len);
+    } else if (strcmp(arg, "play") == 0) {
+        replay_record(0);
+        replay_stop();
+        text = replay_recording(&len);
+        replay_start(text, len);
+    } else if (strcmp(arg, "record") == 0) {
+        replay_record(1);
+    } else if (strcmp(arg, "stop") == 0) {
+        replay_stop();
+        replay_record(0);
+    } else if (strcmp(arg, "dump") == 0) {
+        if (!serial_present()) {
+            write_str("replay dump: no serial port\n");
+            return;
+        }
+        text = replay_recording(&len);
+        k_printf("Sending %u bytes to COM1...\n", len);
+        serial_console_write("#REPLAY begin\n", 14);
+        serial_console_write(text, len);
+        if (len && text[len - 1] != '\n')
+            serial_console_write("\n", 1);
+        serial_console_write("#REPLAY end\n", 12);
+    } else if (arg[0] != '\0' && strcmp(arg, "status") != 0) {
+        write_str("Usage: replay [status|load|play|record|stop|dump]\n");
+        return;
+    }
+
+    replay_get_status(&st);
+    k_printf("Replay %s: %u/%u bytes, %u keys sent, %u skipped\n",
+             st.playing ? "running" : "idle", st.pos, st.len, st.keys, st.skipped);
+    k_printf("Recording %s: %u bytes\n", st.recording ? "on" : "off", st.recorded);
+}
+
+// TSC frequency in MHz, measured once against the PIT over 10 ticks
+static uint32_t tsc_mhz(void) {
+    static uint32_t mhz = 0;
+
+    if (mhz == 0) {
+        uint32_t t = timer_get_ticks();
+        while (timer_get_ticks() == t)
+            __asm__ __volatile__("hlt");
+        uint64_t c0 = rdtsc();
+        t = timer_get_ticks();
+        while (timer_get_ticks() - t < 10)
+            __asm__ __volatile__("hlt");
+        uint64_t d = rdtsc() - c0;
+
+        uint32_t us = 10 * (1000000 / timer_get_hz());
+        mhz = (d >> 32) ? 0xFFFFFFFFu / us : (uint32_t)d / us;
+        if (mhz == 0)
+            mhz = 1;
+    }
+    return mhz;
+}
+
+// Format `cycles` as a time with a unit that keeps 1-4 digits
+static void format_cycles(char *out, uint32_t size, uint64_t cycles, uint32_t mhz) {
+    uint32_t shift = 0;
+    while (cycles >> 32) {
+        cycles >>= 1;
+        shift++;
+    }
+    uint32_t c = (uint32_t)cycles;
+
+    if (shift == 0 && c < 0xFFFFFFFFu / 1000 && c * 1000 / mhz < 10000)
+        k_snprintf(out, size, "%uns", c * 1000 / mhz);
+    else if (shift == 0 && c / mhz < 10000)
+        k_snprintf(out, size, "%uus", c / mhz);
+    else {
+        uint64_t ms = (uint64_t)(c / mhz) << shift;
+        k_divmod_u64(&ms, 1000);
+        k_snprintf(out, size, "%llums", (unsigned long long)ms);
+    }
+}
+
+// `inputlat` prints the input latency histograms side by side, one row per
+// log2 bucket (labelled with its upper bound); `inputlat reset` clears them.
+static void inputlat_command(const char *arg) {
+    static inputlat_hist_t h[INPUTLAT_STAGES];
+    char label[16];
+    int first = INPUTLAT_BUCKETS, last = -1;
+
+    arg = k_skip_ws(arg);
+    if (strcmp(arg, "reset") == 0) {
+        inputlat_reset();
+        write_str("Input latency histograms cleared.\n");
+        return;
+    }
+    if (arg[0] != '\0') {
+        write_str("Usage: inputlat [reset]\n");
+        return;
+    }
+
+    uint32_t mhz = tsc_mhz();
+    for (uint8_t s = 0; s < INPUTLAT_STAGES; s++) {
+        inputlat_get(s, &h[s]);
+        for (int i = 0; i < INPUTLAT_BUCKETS; i++) {
+            if (h[s].buckets[i] == 0)
+                continue;
+            if (i < first) first = i;
+            if (i > last) last = i;
+        }
+    }
+
+    k_printf("Key latency from IRQ1 (TSC %u MHz):\n", mhz);
+    k_printf("%10s", "under");
+    for (uint8_t s = 0; s < INPUTLAT_STAGES; s++)
+        k_printf("%9s", inputlat_stage_name(s));
+    put_char('\n');
+
+    for (int i = first; i <= last; i++) {
+        format_cycles(label, sizeof(label), 2ull << i, mhz);
+        k_printf("%10s", label);
+        for (uint8_t s = 0; s < INPUTLAT_STAGES; s++)
+            k_printf("%9u", h[s].buckets[i]);
+        put_char('\n');
+    }
+
+    k_printf("%10s", "samples");
+    for (uint8_t s = 0; s < INPUTLAT_STAGES; s++)
+        k_printf("%9u", h[s].count);
+    put_char('\n');
+    k_printf("%10s", "max");
+    for (uint8_t s = 0; s < INPUTLAT_STAGES; s++) {
+        format_cycles(label, sizeof(label), h[s].max, mhz);
+        k_printf("%9s", label);
+    }
+    put_char('\n');
+}
+
+static const char *vector_name(uint32_t v, char *buf, uint32_t size) {
+    switch (v) {
+    case IRQ0:  return "timer";
+    case IRQ1:  return "keyboard";
+    case IRQ4:  return "COM1";
+    case IRQ12: return "mouse";
+    case IRQ_BENCH: return "irqbench";
+    }
+    if (v < IRQ_BASE)
+        k_snprintf(buf, size, "exc %u", v);
+    else if (v < IRQ(16))
+        k_snprintf(buf, size, "IRQ%u", v - IRQ_BASE);
+    else
+        k_snprintf(buf, size, "int %u", v);
+    return buf;
+}
+
+// `irqstat` lists every vector that fired, most handler time first;
+// `irqstat <vector>` shows one vector's cost histogram and `irqstat reset`
+// clears the counters.
+static void irqstat_command(const char *arg) {
+    static irq_vector_stat_t st[256];
+    static uint8_t order[256];
+    char name[12], total[16], avg[16], max[16];
+    uint32_t n = 0;
+    int v;
+    const char *end;
+
+    arg = k_skip_ws(arg);
+    if (strcmp(arg, "reset") == 0) {
+        irq_reset_stats();
+        write_str("Interrupt statistics cleared.\n");
+        return;
+    }
+    if (arg[0] != '\0' && (!k_parse_int(arg, &v, &end) || v < 0 || v > 255)) {
+        write_str("Usage: irqstat [reset|<vector>]\n");
+        return;
+    }
+
+    uint32_t mhz = tsc_mhz();
+    if (arg[0] != '\0') {
+        irq_get_vector_stat((uint8_t)v, &st[0]);
+        k_printf("Vector %u (%s): %u dispatched, %u spurious\n", (uint32_t)v,
+                 vector_name((uint32_t)v, name, sizeof(name)), st[0].count, st[0].spurious);
+        for (int i = 0; i < IRQSTAT_BUCKETS; i++) {
+            if (st[0].hist[i] == 0)
+                continue;
+            if (i == IRQSTAT_BUCKETS - 1) {
+                format_cycles(total, sizeof(total), 1ull << i, mhz);
+                k_printf("  over  %8s %10u\n", total, st[0].hist[i]);
+            } else {
+                format_cycles(total, sizeof(total), 2ull << i, mhz);
+                k_printf("  under %8s %10u\n", total, st[0].hist[i]);
+            }
+        }
+        return;
+    }
+
+    // Snapshot every vector, then insertion-sort the active ones by total
+    for (uint32_t i = 0; i < 256; i++) {
+        irq_get_vector_stat((uint8_t)i, &st[i]);
+        if (st[i].count == 0 && st[i].spurious == 0)
+            continue;
+        uint32_t j = n++;
+        for (; j > 0 && st[order[j - 1]].cycles < st[i].cycles; j--)
+            order[j] = order[j - 1];
+        order[j] = (uint8_t)i;
+    }
+
+    k_printf("Interrupt handler cost (TSC %u MHz, %s):\n", mhz,
+             irq_apic_active() ? "I/O APIC" : "8259 PIC");
+    k_printf("%4s %-9s %10s %8s %9s %9s %9s\n",
+             "vec", "source", "count", "spurious", "total", "avg", "max");
+    for (uint32_t k = 0; k < n; k++) {
+        irq_vector_stat_t *s = &st[order[k]];
+        uint64_t mean = s->cycles;
+        if (s->count)
+            k_divmod_u64(&mean, s->count);
+        format_cycles(total, sizeof(total), s->cycles, mhz);
+        format_cycles(avg, sizeof(avg), mean, mhz);
+        format_cycles(max, sizeof(max), s->max_cycles, mhz);
+        k_printf("%4u %-9s %10u %8u %9s %9s %9s\n", (uint32_t)order[k],
+                 vector_name(order[k], name, sizeof(name)),
+                 s->count, s->spurious, total, avg, max);
+    }
+}
+
+// `softirq` shows how often each deferred-work item was raised and run,
+// how long it waited and ran; `softirq reset` clears the counters.
+static void softirq_command(const char *arg) {
+    softirq_stat_t st;
+    char avg[16], wait[16], max[16];
+
+    arg = k_skip_ws(arg);
+    if (strcmp(arg, "reset") == 0) {
+        softirq_reset_stats();
+        write_str("Softirq statistics cleared.\n");
+        return;
+    }
+    if (arg[0] != '\0') {
+        write_str("Usage: softirq [reset]\n");
+        return;
+    }
+
+    uint32_t mhz = tsc_mhz();
+    k_printf("Deferred interrupt work (TSC %u MHz):\n", mhz);
+    k_printf("%-9s %10s %10s %9s %9s %9s\n", "softirq", "raised", "runs", "avg run", "max run", "max wait");
+    for (uint8_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        softirq_get_stat(nr, &st);
+        uint64_t mean = st.cycles;
+        if (st.runs)
+            k_divmod_u64(&mean, st.runs);
+        format_cycles(avg, sizeof(avg), mean, mhz);
+        format_cycles(max, sizeof(max), st.max_cycles, mhz);
+        format_cycles(wait, sizeof(wait), st.max_latency, mhz);
+        k_printf("%-9s %10u %10u %9s %9s %9s\n", st.name ? st.name : "-",
+                 st.raised, st.runs, avg, max, wait);
+    }
+    k_printf("Runs that left work for later: %u\n", softirq_deferred());
+}
+
+// `exit [code]` ends a QEMU session through the isa-debug-exit device
+// (port 0xF4); QEMU exits with status (code << 1) | 1. Used to end
+// unattended runs (`make replay`).
+static void exit_command(const char *arg) {
+    int code = 0;
+    const char *end;
+
+    arg = k_skip_ws(arg);
+    if (arg[0] != '\0' && (!k_parse_int(arg, &code, &end) || code < 0 || code > 127)) {
+        write_str("Usage: exit [0-127]\n");
+        return;
+    }
+    fb_flush();
+    outb(0xF4, (unsigned char)code);
+    write_str("exit: no isa-debug-exit device\n");
+}
+
+// Virtual console assignment (Alt+F1..F4 shows console 0..3).
+#define CONSOLE_SHELL     0
+#define CONSOLE_CALC      1
+#define CONSOLE_TICTACTOE 2
+
+// Send output to console `n` and display it.
+static void enter_console(uint8_t n) {
+    fb_console_select(n);
+    fb_console_show(n);
+    fb_flush();
+}
+
 // Main kernel entry point
-// Called by loader.asm
-void kmain(void) {
+// Called by loader.asm with the Multiboot magic and boot information pointer
+void kmain(uint32_t magic, multiboot_info_t *mbi) {
+    // Draw the console in pixels if the bootloader set up a linear framebuffer
+    // (only requested by the `make GRAPHICS=1` build); otherwise VGA text mode.
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && lfb_init(mbi) == 0)
+        fb_attach_lfb(lfb_cols(), lfb_rows());
+
     // Set up the framebuffer and clear the screen
     init_framebuffer();
 
@@ -119,10 +688,46 @@ void kmain(void) {
     // Populate IDT with ISR (CPU exceptions) and IRQ (hardware interrupts) handlers
     // Also remaps PIC to avoid conflicts with CPU exceptions
     init_interrupt_gates();
+    // Route IRQs through the I/O APIC when the ACPI MADT describes one;
+    // `noapic` on the kernel line (menu.lst) keeps the 8259s
+    const char *cmdline = (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_CMDLINE))
+                          ? (const char *)mbi->cmdline : "";
+    if (boot_option(cmdline, "noapic") || init_apic_routing() < 0)
+        klog(KLOG_INFO, "irq: 8259 PIC");
+
+    // COM1 at 115200 8N1; when present, the console is mirrored to it and
+    // bytes typed on the serial line are read like keystrokes
+    // The kernel log goes to the screen from warnings up (see `dmesg -n`)
+    // and to the serial line from info up.
+    klog_set_sink(KLOG_SINK_CONSOLE, klog_console_write, KLOG_WARN);
+    if (init_serial(115200) == 0) {
+        fb_set_mirror(serial_console_write);
+        klog_set_sink(KLOG_SINK_SERIAL, serial_console_write, KLOG_INFO);
+        klog(KLOG_INFO, "serial: COM1 at 115200 baud");
+    } else {
+        klog(KLOG_INFO, "serial: no UART on COM1");
+    }
+    klog(KLOG_INFO, "fb: %ux%u text console", fb_width(), fb_height());
     
     // Initialize drivers
     // Initialize keyboard driver and register IRQ1 handler
     init_keyboard();
+    // PS/2 mouse on IRQ12: pointer and click-drag selection
+    if (init_mouse() == 0)
+        klog(KLOG_INFO, "mouse: PS/2 on IRQ12");
+    else
+        klog(KLOG_INFO, "mouse: none on the aux port");
+    // Initialize PIT (IRQ0); also drives the periodic framebuffer flush
+    init_timer(TIMER_DEFAULT_HZ);
+    klog(KLOG_INFO, "timer: PIT at %u Hz", timer_get_hz());
+    // A Multiboot module is a key script to type into the shell (make replay)
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_MODS) && mbi->mods_count > 0) {
+        const multiboot_module_t *mod = (const multiboot_module_t *)mbi->mods_addr;
+        replay_start((const char *)mod->mod_start, mod->mod_end - mod->mod_start);
+        klog(KLOG_INFO, "replay: %u-byte key script from boot module", mod->mod_end - mod->mod_start);
+    }
+    // Bottom row: uptime, IRQ counts and the active prompt (redrawn by the timer)
+    status_init();
 
     // Enable interrupts
     // STI instruction enables maskable interrupts
@@ -139,23 +744,27 @@ void kmain(void) {
 
     // Shell Loop: Interactive command-line interface
     // A simple infinite loop that reads commands and executes them
+    // Line editing, history and Tab completion for the prompt
+    static le_prompt_t shell_prompt;
     char buffer[128];
+    char prompt[16];
     int pink_mode = 0; // 0 = Cyan mode (default), 1 = Pink mode
     unsigned char primary_color;
 
+    menu_add_commands(&shell_prompt);
+
     for (;;) {
         // Determine primary color based on mode
         // This feature is not in worksheets, added for customization
         primary_color = pink_mode ? FRAMEBUFFER_COLOR_LIGHT_MAGENTA : FRAMEBUFFER_COLOR_LIGHT_CYAN;
 
-        // Display prompt in primary color
-        set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        write_str("snowos> ");
-        
-        // Set input color to white for user typing
+        // Prompt in primary color, input in white for user typing
         set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
+        k_snprintf(prompt, sizeof(prompt), KCOLOR "snowos> " KCOLOR_RESET, KC(primary_color));
         // Read a line of text from the keyboard driver (blocking call)
-        kbd_readline(buffer, sizeof(buffer));
+        le_readline(&shell_prompt, prompt, buffer, sizeof(buffer));
+        uint32_t cmd_tag = trace_tag(k_skip_ws(buffer));
+        TRACE_BEGIN(TRACE_CMD, cmd_tag);
         
         // Set output color to primary color (for command responses and errors)
         // Individual commands may override this if needed
@@ -167,6 +776,7 @@ void kmain(void) {
         } else if (strcmp(buffer, "pink") == 0) {
             // Custom command to toggle UI color
             pink_mode = !pink_mode;
+            status_set_pink(pink_mode);
             if (pink_mode) {
                 // Set color to pink for the welcome message
                 set_color(FRAMEBUFFER_COLOR_LIGHT_MAGENTA, FRAMEBUFFER_COLOR_BLACK);
@@ -201,15 +811,34 @@ void kmain(void) {
             vga_test();
         } else if (strcmp(buffer, "version") == 0) {
             print_os_version();
+        } else if (strcmp(buffer, "fbstat") == 0) {
+            print_fb_stats();
+        } else if (strcmp(buffer, "fbbench") == 0) {
+            fb_bench();
+        } else if (strcmp(buffer, "serial") == 0) {
+            print_serial_stats();
+        } else if (strcmp(buffer, "irqbench") == 0) {
+            irq_bench_command();
+        } else if (strcmp(buffer, "mouse") == 0) {
+            print_mouse_stats();
         } else if (strncmp(buffer, "echo ", 5) == 0) {
             // Echo back the string after "echo "
             set_color(FRAMEBUFFER_COLOR_LIGHT_GREEN, FRAMEBUFFER_COLOR_BLACK);
             write_str(buffer + 5);
             put_char('\n');
         } else if (strcmp(buffer, "calc") == 0) {
+            // Apps get their own virtual console so the shell's screen survives them.
+            enter_console(CONSOLE_CALC);
+            status_set_mode("calc>");
             calculator_mode(primary_color);
+            status_set_mode("snowos>");
+            enter_console(CONSOLE_SHELL);
         } else if (strcmp(buffer, "tictactoe") == 0) {
+            enter_console(CONSOLE_TICTACTOE);
+            status_set_mode("ttt>");
             tictactoe_mode(primary_color);
+            status_set_mode("snowos>");
+            enter_console(CONSOLE_SHELL);
         } else if (buffer[0] == '\0') {
             // Empty command, just newline
         } else {
@@ -217,7 +846,27 @@ void kmain(void) {
             const char* args = 0;
             int a, b, c;
 
-            if (k_match_cmd(buffer, "task2", &args)) {
+            if (k_match_cmd(buffer, "mode", &args)) {
+                text_mode_command(args);
+            } else if (k_match_cmd(buffer, "dmesg", &args)) {
+                dmesg_command(args);
+            } else if (k_match_cmd(buffer, "trace", &args)) {
+                trace_command(args);
+            } else if (k_match_cmd(buffer, "replay", &args)) {
+                replay_command(args);
+            } else if (k_match_cmd(buffer, "inputlat", &args)) {
+                inputlat_command(args);
+            } else if (k_match_cmd(buffer, "irqstat", &args)) {
+                irqstat_command(args);
+            } else if (k_match_cmd(buffer, "softirq", &args)) {
+                softirq_command(args);
+            } else if (k_match_cmd(buffer, "exit", &args)) {
+                exit_command(args);
+            } else if (k_match_cmd(buffer, "find", &args)) {
+                const char *needle = k_skip_ws(args);
+                if (needle[0] == '\0') write_str("Usage: find <text>\n");
+                else find_in_history(needle);
+            } else if (k_match_cmd(buffer, "task2", &args)) {
                 // Worksheet 2 Part 1 — Task 2: stack argument passing demo
                 // Accepts any three ints; if none given, use the worksheet examples.
                 int ok = 1;
@@ -238,23 +887,12 @@ void kmain(void) {
                     write_str("Task 2 stack-argument passing results:\n");
 
                     set_color(FRAMEBUFFER_COLOR_LIGHT_GREY, FRAMEBUFFER_COLOR_BLACK);
-                    write_str("sum_of_three("); write_dec(a); write_str(", "); write_dec(b); write_str(", "); write_dec(c); write_str(") = ");
-                    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-                    write_dec(s2);
-                    set_color(FRAMEBUFFER_COLOR_LIGHT_GREY, FRAMEBUFFER_COLOR_BLACK);
-                    put_char('\n');
-
-                    write_str("max_of_three("); write_dec(a); write_str(", "); write_dec(b); write_str(", "); write_dec(c); write_str(") = ");
-                    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-                    write_dec(m2);
-                    set_color(FRAMEBUFFER_COLOR_LIGHT_GREY, FRAMEBUFFER_COLOR_BLACK);
-                    put_char('\n');
-
-                    write_str("product_of_three("); write_dec(a); write_str(", "); write_dec(b); write_str(", "); write_dec(c); write_str(") = ");
-                    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-                    write_dec_ll(p2);
-                    set_color(FRAMEBUFFER_COLOR_LIGHT_GREY, FRAMEBUFFER_COLOR_BLACK);
-                    put_char('\n');
+                    k_printf("sum_of_three(%d, %d, %d) = " KCOLOR "%d" KCOLOR_RESET "\n",
+                             a, b, c, KC(primary_color), s2);
+                    k_printf("max_of_three(%d, %d, %d) = " KCOLOR "%d" KCOLOR_RESET "\n",
+                             a, b, c, KC(primary_color), m2);
+                    k_printf("product_of_three(%d, %d, %d) = " KCOLOR "%lld" KCOLOR_RESET "\n",
+                             a, b, c, KC(primary_color), p2);
                 }
             } else {
                 write_str("Unknown command: ");
@@ -262,5 +900,6 @@ void kmain(void) {
                 put_char('\n');
             }
         }
+        TRACE_END(TRACE_CMD, cmd_tag);
     }
 }
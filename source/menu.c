@@ -1,175 +1,108 @@
 #include "framebuffer.h"
+#include "kprintf.h"
 #include "menu.h"
 
-// Local string helpers (no libc in this freestanding environment)
-static int k_strlen(const char *s) {
-    int len = 0;
-    while (*s) {
-        len++;
-        s++;
-    }
-    return len;
+// Command list shown by show_help_menu(), in display order
+static const struct {
+    const char *cmd;
+    const char *desc;
+} help_items[] = {
+    { "help",        "Show this help" },
+    { "clear",       "Clear the screen" },
+    { "task1",       "Demo VGA output (colors/cursor/scroll)" },
+    { "echo [s]",    "Print string s" },
+    { "version",     "Show OS version" },
+    { "find [s]",    "Search scrollback (Shift+PgUp/PgDn)" },
+    { "fbstat",      "Show framebuffer flush counters" },
+    { "fbbench",     "Time screen clear/scroll in cycles" },
+    { "serial",      "Show COM1 byte/drop counters" },
+    { "mouse",       "Show mouse counters and last selection" },
+    { "dmesg [lvl]", "Show kernel log (-n lvl: console level)" },
+    { "trace [op]",  "Tracepoints: on, off, clear, dump to COM1" },
+    { "replay [op]", "Key scripts: load, play, record, stop, dump" },
+    { "inputlat",    "Key latency histograms (reset: clear)" },
+    { "irqstat",     "Interrupt counts and handler cycles" },
+    { "irqbench",    "Time int round trips through IRQ entry" },
+    { "softirq",     "Deferred IRQ work counters (reset: clear)" },
+    { "exit [n]",    "Quit QEMU with status n (isa-debug-exit)" },
+    { "mode [m]",    "Text mode: 80x25, 80x50 or 90x60" },
+    { "shutdown",    "Dividing by zero..." },
+    { "pink",        "Toggle pink mode" },
+    { "calc",        "Enter calculator mode" },
+    { "task2 a b c", "Print Task 2 (sum/max/prod) for a,b,c" },
+    { "tictactoe",   "Play TicTacToe" },
+};
+
+#define HELP_ITEMS (sizeof(help_items) / sizeof(help_items[0]))
+
+// The whole box is formatted into this buffer and written in one go
+static char help_buf[4096];
+
+// Append formatted text to help_buf at *len (truncating at the end)
+static void help_append(int *len, const char *fmt, ...) {
+    __builtin_va_list ap;
+    if (*len >= (int)sizeof(help_buf) - 1)
+        return;
+    __builtin_va_start(ap, fmt);
+    *len += k_vsnprintf(help_buf + *len, sizeof(help_buf) - *len, fmt, ap);
+    __builtin_va_end(ap);
+    if (*len > (int)sizeof(help_buf) - 1)
+        *len = sizeof(help_buf) - 1;
 }
 
-static void write_n_chars(char c, int count) {
-    for (int i = 0; i < count; i++) {
-        put_char(c);
-    }
+// Append n copies of c
+static void help_repeat(int *len, char c, int n) {
+    while (n-- > 0 && *len < (int)sizeof(help_buf) - 1)
+        help_buf[(*len)++] = c;
+    help_buf[*len] = '\0';
 }
 
-// Write a string centered within a given width
-static void write_centered(const char *text, int width) {
-    int len = k_strlen(text);
-    if (len >= width) {
-        write_str(text);
-        return;
-    }
-
-    int left = (width - len) / 2;
-    int right = width - len - left;
-
-    write_n_chars(' ', left);
-    write_str(text);
-    write_n_chars(' ', right);
+static void help_border(int *len, int inner_width) {
+    help_append(len, "+");
+    help_repeat(len, '-', inner_width);
+    help_append(len, "+\n");
 }
 
 // Public API: draw the "Available commands" help menu
 void show_help_menu(uint8_t primary_color) {
     const int box_width = 60;
     const int inner_width = box_width - 2;
+    const char *title = "Available commands";
+    int p = FB_ANSI_FG(primary_color);
+    int w = FB_ANSI_FG(FRAMEBUFFER_COLOR_WHITE);
+    int len = 0;
 
-    // Use the primary color for the box border / command names
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    put_char('\n');
-
-    // Top border
-    put_char('+');
-    write_n_chars('-', inner_width);
-    put_char('+');
-    put_char('\n');
+    // White box border, command names in the primary colour
+    help_append(&len, FB_CSI "40;%dm\n", w);
+    help_border(&len, inner_width);
 
     // Centered title
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_centered("Available commands", inner_width);
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    put_char('|');
-    put_char('\n');
-
-    // Separator
-    put_char('+');
-    write_n_chars('-', inner_width);
-    put_char('+');
-    put_char('\n');
-
-    // Command list lines, nicely indented
-    const char *line;
-
-    line = "  help      - Show this help";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  help");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("      - Show this help");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  clear     - Clear the screen";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  clear");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("     - Clear the screen");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  task1     - Demo VGA output (colors/cursor/scroll)";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  task1");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("     - Demo VGA output (colors/cursor/scroll)");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  echo [s]  - Print string s";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  echo [s]");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  - Print string s");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  version   - Show OS version";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  version");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("   - Show OS version");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  shutdown  - Dividing by zero...";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  shutdown");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  - Dividing by zero...");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  pink      - Toggle pink mode";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  pink");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("      - Toggle pink mode");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  calc      - Enter calculator mode";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  calc");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("      - Enter calculator mode");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  task2 a b c - Print Task 2 (sum/max/prod) for a,b,c";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  task2 a b c");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str(" - Print Task 2 (sum/max/prod) for a,b,c");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    line = "  tictactoe - Play TicTacToe";
-    put_char('|');
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("  tictactoe");
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str(" - Play TicTacToe");
-    write_n_chars(' ', inner_width - k_strlen(line));
-    put_char('|');
-    put_char('\n');
-
-    // Bottom border
-    put_char('+');
-    write_n_chars('-', inner_width);
-    put_char('+');
-    put_char('\n');
+    int title_len = k_snprintf(0, 0, "%s", title);
+    int left = (inner_width - title_len) / 2;
+    help_append(&len, "|");
+    help_repeat(&len, ' ', left);
+    help_append(&len, FB_CSI "%dm%s" FB_CSI "%dm", p, title, w);
+    help_repeat(&len, ' ', inner_width - title_len - left);
+    help_append(&len, "|\n");
+
+    help_border(&len, inner_width);
+
+    for (unsigned i = 0; i < HELP_ITEMS; i++) {
+        int n = k_snprintf(0, 0, "  %-9s - %s", help_items[i].cmd, help_items[i].desc);
+        help_append(&len, "|  " FB_CSI "%dm%-9s" FB_CSI "%dm - %s",
+                    p, help_items[i].cmd, w, help_items[i].desc);
+        help_repeat(&len, ' ', inner_width - n);
+        help_append(&len, "|\n");
+    }
+
+    help_border(&len, inner_width);
+    write_str(help_buf);
+}
+
+// Public API: register the shell command names (for Tab completion)
+void menu_add_commands(le_prompt_t *prompt) {
+    for (unsigned i = 0; i < HELP_ITEMS; i++)
+        le_add_command(prompt, help_items[i].cmd);
 }
 
 // --- Worksheet 2 Part 1 — Task 2 ---
@@ -4,10 +4,14 @@
 #define MENU_H
 
 #include "types.h"
+#include "lineedit.h"
 
 // Display the nicely formatted "Available commands" box
 void show_help_menu(uint8_t primary_color);
 
+// Register the commands listed in the help menu with a prompt (Tab completion)
+void menu_add_commands(le_prompt_t *prompt);
+
 // Enters calculator mode; returns to OS shell when user types "quit".
 void calculator_mode(uint8_t primary_color);
 
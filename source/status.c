@@ -0,0 +1,46 @@
+#include "framebuffer.h"
+#include "isr.h"
+#include "kprintf.h"
+#include "timer.h"
+#include "status.h"
+
+// Set from the shell; the timer hook redraws the line when they change.
+static const char *volatile status_mode = "snowos>";
+static volatile uint8_t status_pink = 0;
+static volatile uint8_t status_stale = 1;
+
+// Redraw once a second (for the uptime and IRQ counts) or when the shell
+// changed something. Runs in the timer softirq: everything it touches is either
+// its own or written by fb_status_set(), which is IRQ-safe.
+static void status_tick(uint32_t ticks) {
+    static uint32_t last_second = 0xFFFFFFFFu;
+    uint32_t hz = timer_get_hz();
+    uint32_t second = hz ? ticks / hz : 0;
+
+    if (second == last_second && !status_stale)
+        return;
+    last_second = second;
+    status_stale = 0;
+
+    char line[FB_MAX_WIDTH + 1];
+    k_snprintf(line, sizeof(line), " up %u:%02u:%02u | irq0 %u irq1 %u | %s%s",
+               second / 3600, (second / 60) % 60, second % 60,
+               irq_get_count(0), irq_get_count(1),
+               status_mode, status_pink ? " | pink" : "");
+    fb_status_set(line, FB_ATTR(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLUE));
+}
+
+void status_init(void) {
+    fb_status_enable(1);
+    timer_set_hook(status_tick);
+}
+
+void status_set_mode(const char *mode) {
+    status_mode = mode;
+    status_stale = 1;
+}
+
+void status_set_pink(int on) {
+    status_pink = on ? 1 : 0;
+    status_stale = 1;
+}
@@ -0,0 +1,16 @@
+// status.h - the status line at the bottom of the screen
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include "types.h"
+
+// Reserve the bottom screen row and keep it updated from the timer tick:
+// uptime, timer/keyboard IRQ counts, the active prompt and pink mode.
+void status_init(void);
+
+// What the user is talking to ("snowos>", "calc>", "ttt>").
+void status_set_mode(const char *mode);
+void status_set_pink(int on);
+
+#endif // STATUS_H
@@ -1,20 +1,23 @@
 #include "framebuffer.h"
-#include "keyboard.h"
+#include "lineedit.h"
+#include "kprintf.h"
 #include "menu.h"
 
+// SGR escape selecting foreground colour %d on black
+#define TTT_COLOR FB_CSI "40;%dm"
+
 static void ttt_print_help(uint8_t primary_color) {
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("\n=== TicTacToe ===\n");
-
-    set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-    write_str("Moves:\n");
-    write_str("  Type a number 1-9 to place your mark.\n\n");
-
-    write_str("Commands:\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  help");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("      -> show this menu\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  clear"); set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("     -> clear screen + redraw board\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  restart"); set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("   -> restart the game (optionally: restart x|o)\n");
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK); write_str("  quit");  set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK); write_str("      -> return to OS\n");
+    int p = FB_ANSI_FG(primary_color);
+    int w = FB_ANSI_FG(FRAMEBUFFER_COLOR_WHITE);
+
+    k_printf(TTT_COLOR "\n=== TicTacToe ===\n"
+             TTT_COLOR "Moves:\n"
+             "  Type a number 1-9 to place your mark.\n\n"
+             "Commands:\n", p, w);
+    k_printf(TTT_COLOR "  help"    TTT_COLOR "      -> show this menu\n"
+             TTT_COLOR "  clear"   TTT_COLOR "     -> clear screen + redraw board\n", p, w, p, w);
+    k_printf(TTT_COLOR "  restart" TTT_COLOR "   -> restart the game (optionally: restart x|o)\n"
+             TTT_COLOR "  quit"    TTT_COLOR "      -> return to OS\n", p, w, p, w);
 }
 
 static char ttt_cell_char(uint8_t cell, int cell_index) {
@@ -25,6 +28,12 @@ static char ttt_cell_char(uint8_t cell, int cell_index) {
     return (char)('1' + cell_index);
 }
 
+static int ttt_cell_color(uint8_t cell) {
+    if (cell == 1) return FB_ANSI_FG(FRAMEBUFFER_COLOR_LIGHT_RED);
+    if (cell == 2) return FB_ANSI_FG(FRAMEBUFFER_COLOR_LIGHT_GREEN);
+    return FB_ANSI_FG(FRAMEBUFFER_COLOR_WHITE);
+}
+
 static int ttt_won(const uint8_t board[9], uint8_t player) {
     static const uint8_t w[8][3] = {
         {0, 1, 2}, {3, 4, 5}, {6, 7, 8}, // rows
@@ -46,39 +55,27 @@ static int ttt_full(const uint8_t board[9]) {
     return 1;
 }
 
+// Clear the screen and draw the header and board as one escape-coded
+// string, so the whole frame reaches the screen in a single write.
 static void ttt_draw(const uint8_t board[9], uint8_t primary_color) {
-    // Header
-    set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-    write_str("TicTacToe  (type 'help' for commands)\n\n");
+    char frame[320];
+    int w = FB_ANSI_FG(FRAMEBUFFER_COLOR_WHITE);
+    int n = k_snprintf(frame, sizeof(frame),
+                       TTT_COLOR FB_ANSI_CLEAR "TicTacToe  (type 'help' for commands)\n\n",
+                       FB_ANSI_FG(primary_color));
 
-    // Board
     for (int r = 0; r < 3; r++) {
         int i = r * 3;
-        set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        put_char(' ');
-        if (board[i + 0] == 1) set_color(FRAMEBUFFER_COLOR_LIGHT_RED, FRAMEBUFFER_COLOR_BLACK);
-        else if (board[i + 0] == 2) set_color(FRAMEBUFFER_COLOR_LIGHT_GREEN, FRAMEBUFFER_COLOR_BLACK);
-        else set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        put_char(ttt_cell_char(board[i + 0], i + 0));
-        set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        write_str(" | ");
-        if (board[i + 1] == 1) set_color(FRAMEBUFFER_COLOR_LIGHT_RED, FRAMEBUFFER_COLOR_BLACK);
-        else if (board[i + 1] == 2) set_color(FRAMEBUFFER_COLOR_LIGHT_GREEN, FRAMEBUFFER_COLOR_BLACK);
-        else set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        put_char(ttt_cell_char(board[i + 1], i + 1));
-        set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        write_str(" | ");
-        if (board[i + 2] == 1) set_color(FRAMEBUFFER_COLOR_LIGHT_RED, FRAMEBUFFER_COLOR_BLACK);
-        else if (board[i + 2] == 2) set_color(FRAMEBUFFER_COLOR_LIGHT_GREEN, FRAMEBUFFER_COLOR_BLACK);
-        else set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        put_char(ttt_cell_char(board[i + 2], i + 2));
-        set_color(FRAMEBUFFER_COLOR_WHITE, FRAMEBUFFER_COLOR_BLACK);
-        put_char('\n');
-        if (r < 2) {
-            write_str("---+---+---\n");
-        }
+        n += k_snprintf(frame + n, sizeof(frame) - n,
+                        " " FB_CSI "%dm%c" FB_CSI "%dm | "
+                        FB_CSI "%dm%c" FB_CSI "%dm | "
+                        FB_CSI "%dm%c" FB_CSI "%dm\n%s",
+                        ttt_cell_color(board[i + 0]), ttt_cell_char(board[i + 0], i + 0), w,
+                        ttt_cell_color(board[i + 1]), ttt_cell_char(board[i + 1], i + 1), w,
+                        ttt_cell_color(board[i + 2]), ttt_cell_char(board[i + 2], i + 2), w,
+                        (r < 2) ? "---+---+---\n" : "\n");
     }
-    put_char('\n');
+    write_str(frame);
 }
 
 // Parse a single-digit move 1..9, allowing surrounding whitespace.
@@ -96,6 +93,11 @@ static int ttt_parse_move(const char *s, int *out_idx) {
     return 1;
 }
 
+// Prompt state (history, Tab completion) kept across games
+static le_prompt_t ttt_prompt;
+
+static const char *const ttt_commands[] = { "help", "clear", "restart", "quit" };
+
 void tictactoe_mode(uint8_t primary_color) {
     uint8_t board[9];
     for (int i = 0; i < 9; i++) board[i] = 0;
@@ -105,25 +107,20 @@ void tictactoe_mode(uint8_t primary_color) {
     char buf[128];
     int game_over = 0;
 
-    clear_screen();
+    if (ttt_prompt.commands.used == 0)
+        for (unsigned i = 0; i < sizeof(ttt_commands) / sizeof(ttt_commands[0]); i++)
+            le_add_command(&ttt_prompt, ttt_commands[i]);
+
     ttt_draw(board, primary_color);
     ttt_print_help(primary_color);
 
     for (;;) {
         // Display whose turn it is (with requested colors).
-        set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        write_str("Player's ");
-        if (player == 1) set_color(FRAMEBUFFER_COLOR_LIGHT_RED, FRAMEBUFFER_COLOR_BLACK);
-        else set_color(FRAMEBUFFER_COLOR_LIGHT_GREEN, FRAMEBUFFER_COLOR_BLACK);
-        put_char(player == 1 ? 'X' : 'O');
-        set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        write_str(" turn\n");
-
-        set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        write_str("ttt> ");
+        k_printf(TTT_COLOR "Player's " FB_CSI "%dm%c" FB_CSI "%dm turn\n",
+                 FB_ANSI_FG(primary_color), ttt_cell_color(player),
+                 player == 1 ? 'X' : 'O', FB_ANSI_FG(primary_color));
 
-        set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-        kbd_readline(buf, sizeof(buf));
+        le_readline(&ttt_prompt, "ttt> ", buf, sizeof(buf));
 
         // Normalize output color
         set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
@@ -152,7 +149,6 @@ void tictactoe_mode(uint8_t primary_color) {
             if (k_skip_ws(args)[0] != '\0') {
                 write_str("Usage: clear\n");
             } else {
-                clear_screen();          // explicit utilization of "clear"
                 ttt_draw(board, primary_color);
             }
             continue;
@@ -174,7 +170,6 @@ void tictactoe_mode(uint8_t primary_color) {
             for (int i = 0; i < 9; i++) board[i] = 0;
             game_over = 0;
             player = start;
-            clear_screen();
             ttt_draw(board, primary_color);
             continue;
         }
@@ -201,18 +196,13 @@ void tictactoe_mode(uint8_t primary_color) {
 
         board[idx] = player;
 
-        clear_screen();
         ttt_draw(board, primary_color);
 
         if (ttt_won(board, player)) {
-            set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-            write_str("Winner: ");
-            if (player == 1) set_color(FRAMEBUFFER_COLOR_LIGHT_RED, FRAMEBUFFER_COLOR_BLACK);
-            else set_color(FRAMEBUFFER_COLOR_LIGHT_GREEN, FRAMEBUFFER_COLOR_BLACK);
-            put_char(player == 1 ? 'X' : 'O');
-            put_char('\n');
-            set_color(primary_color, FRAMEBUFFER_COLOR_BLACK);
-            write_str("Type 'restart' to play again, or 'quit' to return to the OS.\n");
+            k_printf(TTT_COLOR "Winner: " FB_CSI "%dm%c\n" FB_CSI "%dm"
+                     "Type 'restart' to play again, or 'quit' to return to the OS.\n",
+                     FB_ANSI_FG(primary_color), ttt_cell_color(player),
+                     player == 1 ? 'X' : 'O', FB_ANSI_FG(primary_color));
             game_over = 1;
             continue;
         }
@@ -0,0 +1,161 @@
+/* trace2json: convert a `trace dump` captured from the serial line into
+ * Chrome trace JSON (load it in chrome://tracing or ui.perfetto.dev).
+ *
+ *   build/trace2json serial.log > trace.json
+ *
+ * Built for the host (`make trace2json`); everything before the dump
+ * header in the input (shell output, boot messages) is skipped.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "trace_events.h"
+
+#define ID_ENTRY(id, name, arg) id,
+enum { TRACE_EVENTS(ID_ENTRY) };
+#undef ID_ENTRY
+
+#define NAME_ENTRY(id, name, arg) name,
+static const char *const event_names[] = { TRACE_EVENTS(NAME_ENTRY) };
+#undef NAME_ENTRY
+
+#define NUM_NAMES (sizeof(event_names) / sizeof(event_names[0]))
+
+typedef struct {
+    uint64_t tsc;
+    uint16_t id;
+    uint8_t phase;
+    uint32_t arg;
+} event_t;
+
+static int hexval(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* One event line: 16 bytes as 32 hex digits, little-endian fields */
+static int parse_event(const char *s, event_t *e) {
+    uint8_t b[16];
+
+    for (int i = 0; i < 16; i++) {
+        int hi = hexval((unsigned char)s[2 * i]);
+        int lo = (hi < 0) ? -1 : hexval((unsigned char)s[2 * i + 1]);
+        if (lo < 0)
+            return -1;
+        b[i] = (uint8_t)(hi << 4 | lo);
+    }
+
+    e->tsc = 0;
+    for (int i = 7; i >= 0; i--)
+        e->tsc = e->tsc << 8 | b[i];
+    e->id = (uint16_t)(b[8] | b[9] << 8);
+    e->phase = b[10];
+    e->arg = (uint32_t)b[12] | (uint32_t)b[13] << 8 | (uint32_t)b[14] << 16 | (uint32_t)b[15] << 24;
+    return 0;
+}
+
+static uint64_t header_field(const char *line, const char *key, int base) {
+    char pat[32];
+    snprintf(pat, sizeof(pat), " %s=", key);
+    const char *p = strstr(line, pat);
+    return p ? strtoull(p + strlen(pat), NULL, base) : 0;
+}
+
+static void print_name(const event_t *e) {
+    const char *name = (e->id < NUM_NAMES) ? event_names[e->id] : "unknown";
+
+    if (e->id == TRACE_CMD) {
+        char tag[5] = { 0 };
+        for (int i = 0; i < 4; i++) {
+            char c = (char)(e->arg >> (8 * i));
+            tag[i] = (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') ? c : '\0';
+            if (!tag[i])
+                break;
+        }
+        printf("%s %s", name, tag);
+    } else if (e->id == TRACE_IRQ) {
+        printf("%s%u", name, e->arg);
+    } else {
+        printf("%s", name);
+    }
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    char line[512];
+    int in_dump = 0, first = 1;
+    uint64_t tsc_hz = 0, tsc_base = 0;
+    unsigned long events = 0;
+
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "-h") == 0)) {
+        fprintf(stderr, "usage: %s [serial.log]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && !(in = fopen(argv[1], "r"))) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (!in_dump) {
+            const char *hdr = strstr(line, TRACE_DUMP_MAGIC);
+            if (!hdr)
+                continue;
+
+            /* TSC rate from the two (tsc, tick) samples in the header */
+            uint64_t hz = header_field(hdr, "hz", 10);
+            uint64_t tsc0 = header_field(hdr, "tsc0", 16);
+            uint64_t tsc1 = header_field(hdr, "tsc1", 16);
+            uint64_t tick0 = header_field(hdr, "tick0", 10);
+            uint64_t tick1 = header_field(hdr, "tick1", 10);
+            if (hz && tick1 > tick0 && tsc1 > tsc0)
+                tsc_hz = (tsc1 - tsc0) * hz / (tick1 - tick0);
+            if (tsc_hz == 0) {
+                fprintf(stderr, "trace2json: cannot derive the TSC rate, assuming 1 GHz\n");
+                tsc_hz = 1000000000ull;
+            }
+            fprintf(stderr, "trace2json: %llu events (%llu lost), TSC %.1f MHz\n",
+                    (unsigned long long)header_field(hdr, "events", 10),
+                    (unsigned long long)header_field(hdr, "lost", 10), tsc_hz / 1e6);
+
+            in_dump = 1;
+            printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+            continue;
+        }
+
+        if (strncmp(line, TRACE_DUMP_END, strlen(TRACE_DUMP_END)) == 0)
+            break;
+
+        event_t e;
+        if (strlen(line) < 32 || parse_event(line, &e) != 0) {
+            fprintf(stderr, "trace2json: skipping malformed line: %s\n", line);
+            continue;
+        }
+        if (first)
+            tsc_base = e.tsc;
+
+        printf("%s{\"name\":\"", first ? "" : ",\n");
+        print_name(&e);
+        printf("\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1",
+               e.phase, (double)(e.tsc - tsc_base) * 1e6 / (double)tsc_hz);
+        if (e.phase == 'i')
+            printf(",\"s\":\"t\"");
+        printf(",\"args\":{\"arg\":%u}}", e.arg);
+        first = 0;
+        events++;
+    }
+
+    if (!in_dump) {
+        fprintf(stderr, "trace2json: no \"%s\" header in the input\n", TRACE_DUMP_MAGIC);
+        return 1;
+    }
+    printf("\n]}\n");
+    fprintf(stderr, "trace2json: wrote %lu events\n", events);
+    return 0;
+}